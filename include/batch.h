@@ -0,0 +1,10 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "run.h"
+
+/* Triangulate every tile listed in a manifest
+ */
+void runBatch(const char *manifest, const Options *options);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef CONSTRAIN_H
+#define CONSTRAIN_H
+
+#include "defs.h"
+
+/* Constrained edges (breaklines), see constrain.c
+ */
+void insertSegment(Point *a, Point *b, EdgeList *edge_list);
+void insertSegments(Point *points, const size_t *segments, size_t num_segments, EdgeList *edge_list);
+
+#endif
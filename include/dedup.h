@@ -0,0 +1,14 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "defs.h"
+
+/* Exact duplicates among points[0 .. num_points - 1].
+ * unique gets the first of every distinct point, in
+ * order, and representative (if not NULL) the index
+ * of the point kept for each point. Returns the
+ * number kept
+ */
+size_t removeDuplicates(Point points[], size_t num_points, Point *unique[], size_t *representative);
+
+#endif
@@ -6,10 +6,30 @@
 typedef struct Point Point;
 typedef struct Edge Edge;
 typedef struct ExtremeEdge ExtremeEdge;
+
+/* Coordinate width is fixed at compile time.
+ * The narrow variant stores 32-bit coordinates and
+ * is exact for |x|, |y| < NARROW_COORD_LIMIT, the
+ * wide variant stores 64-bit coordinates and is
+ * exact for |x|, |y| < 2^62.
+ * AREA holds orientation determinants and POWER
+ * holds inCircle determinants
+ */
+#define NARROW_COORD_LIMIT (1L << 29)
+#ifdef NARROW_COORDS
+typedef int VALUE;
+#define VALUE_SPEC "%d"
+typedef long long AREA;
+#else
 typedef long VALUE;
 #define VALUE_SPEC "%ld"
+__extension__ typedef __int128 AREA;
+#endif
+__extension__ typedef __int128 POWER;
 typedef struct EdgeList EdgeList;
 typedef struct PointList PointList;
+typedef struct Triangle Triangle;
+typedef struct TriangleList TriangleList;
 
 /* By convention:
  *  Positive rotation about a point
@@ -42,20 +62,53 @@ struct ExtremeEdge
     Edge *top_edge_cw;
 };
 
+/* original holds the coordinates read for each
+ * point (x_0 y_0 x_1 y_1 ...) when they were
+ * quantized from floating point, and is NULL
+ * otherwise. It is only used for output
+ */
 struct PointList
 {
     Point *points;
     Point **unused_points;
     size_t idx;
     size_t size;
+    const double *original;
 };
 
+/* An edge list with a parent has no stack of
+ * its own and takes from (and frees to) the
+ * parent's, one thread at a time.
+ * fixed flags the half-edges of constraints by
+ * slot (see constrain.c), and is NULL until one
+ * is inserted. Slices share their parent's
+ */
 struct EdgeList
 {
     Edge *edges;
     Edge **unused_edges;
     size_t idx;
     size_t size;
+    EdgeList *parent;
+    char *fixed;
+};
+
+/* Alternative triangle-based representation.
+ * Vertices are indices into a point array, in
+ * counter-clockwise order. n[i] is the triangle
+ * across the edge opposite v[i] (-1 on the hull)
+ */
+struct Triangle
+{
+    int v[3];
+    int n[3];
+};
+
+struct TriangleList
+{
+    Triangle *triangles;
+    size_t idx;
+    size_t size;
 };
 
 /* Usefull macros
@@ -2,18 +2,32 @@
 #define DELAUNAY_H
 
 #include "defs.h"
+#include "stream.h"
 
 EdgeList *initializeEdgeList(size_t num_points);
+void resetEdgeList(EdgeList *edge_list, size_t num_points);
 
 /* Final delaunay functions
  */
 ExtremeEdge *delaunay_horizontal(Point *points_sorted[], size_t num_points, EdgeList *edge_list);
 ExtremeEdge *delaunay_vertical(Point *points_sorted[], size_t num_points, EdgeList *edge_list);
+ExtremeEdge *delaunayStreamed(Point *points_sorted[], size_t num_points, EdgeList *edge_list, Stream *stream);
 
 /* Auxillary functions for delaunay functions
  */
+size_t edgeCapacity(size_t num_points);
+void splitEdgeList(EdgeList *edge_list, size_t num_first, size_t num_second, EdgeList *first, EdgeList *second);
+void joinEdgeLists(EdgeList *edge_list, EdgeList *first, EdgeList *second);
+
+void delaunay2(Point *point_list[], EdgeList *edge_list, ExtremeEdge *ex);
+void delaunay3(Point *point_list[], EdgeList *edge_list, ExtremeEdge *ex);
+void mergeHorizontal(ExtremeEdge *left_ex, ExtremeEdge *right_ex, Point *split,
+                     size_t num_points, EdgeList *edge_list, ExtremeEdge *ex);
+void mergeVertical(ExtremeEdge *bottom_ex, ExtremeEdge *top_ex, Point *split,
+                   size_t num_points, EdgeList *edge_list, ExtremeEdge *ex);
 Edge *makeLowerCommonTangent(Edge *left_edge, Edge *right_edge);
 Edge *nextCrossEdge(Edge *base, EdgeList *edge_list);
+Edge *nextCrossEdgeBefore(Edge *base, Edge *stop, EdgeList *edge_list);
 
 void deleteAndTriangulate(Point *p, PointList *point_list, EdgeList *edge_list);
 void triangulateEmptyPolygon(Edge *e, EdgeList *edge_list);
@@ -0,0 +1,18 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdio.h>
+#include "defs.h"
+
+/* Which triangles to keep. A bound of 0 is off
+ */
+typedef struct
+{
+    double max_edge;  // longest edge of a kept triangle
+    double alpha;     // largest circumradius of a kept triangle
+} Filter;
+
+void writeFilteredEdges(PointList *point_list, EdgeList *edge_list, const Filter *filter,
+                        FILE *out, FILE *boundary_out);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdio.h>
+#include "defs.h"
+
+/* Graphs drawn from the triangulation, see graph.c.
+ * Both are called from one thread of a team, and
+ * spread their work over it as tasks
+ */
+Edge **spanningTree(PointList *point_list, EdgeList *edge_list, size_t *num_tree_edges);
+Point **nearestNeighbours(PointList *point_list, Point *point_ptr_list[], size_t num_points, size_t k);
+
+void writeSpanningTree(PointList *point_list, Edge **tree, size_t num_tree_edges, FILE *out);
+void writeNearestNeighbours(PointList *point_list, Point **neighbours, size_t k, FILE *out);
+
+#endif
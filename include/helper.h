@@ -8,6 +8,13 @@
 int compareXY(Point *a, Point *b);
 int compareYX(Point *a, Point *b);
 void quickselect(Point *point_list[], size_t l, size_t r, size_t k, int (*lessThan)(Point *, Point *));
+void quicksort(Point *point_list[], size_t l, size_t r, int (*lessThan)(Point *, Point *));
 size_t partition(Point *point_list[], size_t l, size_t r, size_t k, int (*lessThan)(Point *, Point *));
 
+/* Threading
+ */
+int teamSize(void);
+int threadIndex(void);
+double seconds(void);
+
 #endif
@@ -0,0 +1,14 @@
+#ifndef HULL_H
+#define HULL_H
+
+#include <stdio.h>
+#include "defs.h"
+
+/* Convex hull without the triangulation, see hull.c.
+ * Called from one thread of a team, and spreads its
+ * work over it as tasks
+ */
+size_t convexHull(Point *point_list[], size_t num_points);
+void writeHull(PointList *point_list, Point *hull[], size_t hull_size, FILE *out);
+
+#endif
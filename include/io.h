@@ -1,12 +1,38 @@
 #ifndef IO_H
 #define IO_H
 
+#include <stdio.h>
 #include "defs.h"
 
 PointList *getPoints(const char *filename);
+PointList *getPointsWithCapacity(const char *filename, size_t extra);
+long *readCoordinates(const char *filename, size_t *num_points, long *max_abs);
+long *streamCoordinates(const char *filename, size_t *num_points, long *max_abs);
 void showPoint(Point *p);
 void showPoints(Point *point_list[], size_t num_points);
 void showEdge(Edge *e);
 void showEdges(PointList *point_list);
+void writeEdges(PointList *point_list, FILE *out);
+
+/* Output text of a point (its index, or its coordinates
+ * with COORD_OUTPUT) and of an edge line
+ */
+#define POINT_TEXT_MAX 64
+#define EDGE_TEXT_MAX (2 * POINT_TEXT_MAX + 2)
+int formatPoint(char *text, const PointList *point_list, const Point *p);
+int formatEdge(char *text, const PointList *point_list, const Edge *e);
+
+/* Floating-point input
+ */
+double *readFloatCoordinates(const char *filename, size_t *num_points);
+long *quantizeCoordinates(const double *original, size_t num_points, int *exponent);
+
+/* Constrained edges, as pairs of point indices
+ */
+size_t *readSegments(const char *filename, size_t num_points, size_t *num_segments);
+
+/* Heights, as a third column of the points
+ */
+double *readHeights(const char *filename, size_t num_points);
 
 #endif
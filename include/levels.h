@@ -0,0 +1,24 @@
+#ifndef LEVELS_H
+#define LEVELS_H
+
+#include "defs.h"
+
+/* Work done on one level of the merge tree,
+ * level 0 being the root
+ */
+typedef struct
+{
+    size_t leaves;
+    size_t merges;
+    double split_seconds;
+    double merge_seconds;
+} LevelStats;
+
+/* Same triangulation as delaunay_horizontal, merged
+ * level by level. stats may be NULL, otherwise it is
+ * set to a malloc'ed array of num_levels entries
+ */
+ExtremeEdge *delaunayLevels(Point *point_list[], size_t num_points, EdgeList *edge_list,
+                            LevelStats **stats, size_t *num_levels);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+#include <threads.h>
+
+/* Bounded queue of byte blocks between two threads.
+ * push waits while the queue is full, so a fast
+ * producer can never run more than capacity blocks
+ * ahead of its consumer
+ */
+typedef struct
+{
+    char *data;
+    size_t size;
+} Block;
+
+typedef struct
+{
+    Block *blocks;
+    size_t head;
+    size_t count;
+    size_t capacity;
+    int closed;
+    mtx_t lock;
+    cnd_t not_empty;
+    cnd_t not_full;
+} Queue;
+
+Queue *initializeQueue(size_t capacity);
+void pushBlock(Queue *queue, Block block);
+int popBlock(Queue *queue, Block *block);
+void closeQueue(Queue *queue);
+void freeQueue(Queue *queue);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include "defs.h"
+
+/* Regional bulk update: removes the points inside
+ * the box and inserts new_points. Only the first of
+ * repeated new points is inserted, and none at the
+ * place of a point that is kept, so any new points
+ * may be passed. Returns the number removed
+ */
+size_t replaceRegion(VALUE x_min, VALUE y_min, VALUE x_max, VALUE y_max,
+                     Point new_points[], size_t num_new,
+                     PointList *point_list, EdgeList *edge_list);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef RUN_H
+#define RUN_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Options shared by every coordinate width
+ */
+enum { BACKEND_EDGE, BACKEND_TRIANGLE };
+
+typedef struct
+{
+    int backend;
+    int timing;
+    int threads; // 0 leaves the OpenMP default
+    int pipeline;
+    int levels;   // bottom-up merges, see levels.c
+    int verify;   // check the triangulation, see verify.c
+    double max_edge;       // filters, see filter.c
+    double alpha;
+    const char *boundary;  // file for the boundary polygons
+    const char *duplicates; // file for the dropped duplicates
+    const char *constraints; // file of segments, see constrain.c
+    int emst;     // graphs written instead, see graph.c
+    int knn;
+    int hull;     // only the convex hull, see hull.c
+    double simplify; // height tolerance, see simplify.c
+} Options;
+
+/* Entry points for each coordinate width.
+ * Both take ownership of xy (x_0 y_0 x_1 y_1 ...),
+ * triangulate and print the edges. original holds
+ * the coordinates xy was quantized from, or is NULL,
+ * and heights those read for simplify, or is NULL
+ */
+#define VISIBLE __attribute__((visibility("default")))
+
+VISIBLE void runNarrow(long *xy, const double *original, const double *heights, size_t num_points,
+                       const Options *options);
+VISIBLE void runWide(long *xy, const double *original, const double *heights, size_t num_points,
+                     const Options *options);
+
+/* Batch tiles, see batch.c. A workspace holds
+ * the arenas one worker recycles between tiles
+ * of one width, and starts out NULL
+ */
+typedef struct Workspace Workspace;
+
+VISIBLE void runTileNarrow(long *xy, size_t num_points, FILE *out, Workspace **workspace);
+VISIBLE void runTileWide(long *xy, size_t num_points, FILE *out, Workspace **workspace);
+VISIBLE void freeWorkspaceNarrow(Workspace *workspace);
+VISIBLE void freeWorkspaceWide(Workspace *workspace);
+
+#endif
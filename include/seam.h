@@ -0,0 +1,11 @@
+#ifndef SEAM_H
+#define SEAM_H
+
+#include "defs.h"
+
+/* Merge seams
+ */
+Edge *zipSeam(Edge *base, ExtremeEdge *first_ex, ExtremeEdge *second_ex,
+              Point *split, int vertical, size_t num_points, EdgeList *edge_list);
+
+#endif
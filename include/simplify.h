@@ -0,0 +1,12 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "defs.h"
+
+/* Terrain simplification by greedy insertion, see
+ * simplify.c. Called from one thread of a team
+ */
+TriangleList *simplifyTerrain(Point *points, const double *heights, Point *point_ptr_list[], size_t num_points,
+                              double tolerance, int **chain, size_t *chain_size, size_t *num_kept);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include "defs.h"
+
+/* Open rectangle x_lo < x < x_hi, y_lo < y < y_hi around
+ * a block of points. Bounds may be infinite
+ */
+typedef struct
+{
+    long double x_lo;
+    long double x_hi;
+    long double y_lo;
+    long double y_hi;
+} Cell;
+
+/* Edge output written by its own thread while
+ * the triangulation is still being merged
+ */
+typedef struct Stream Stream;
+
+Stream *openStream(PointList *point_list, EdgeList *edge_list, FILE *out);
+void streamBlock(Stream *stream, Point *point_list[], size_t num_points, const Cell *cell);
+void closeStream(Stream *stream);
+
+#endif
@@ -6,6 +6,8 @@
 /* Point functions
  */
 
+PointList *initializePointList(size_t capacity);
+void resetPointList(PointList *point_list, size_t capacity);
 Point *getPoint(PointList *point_list);
 Point *makePoint(VALUE x, VALUE y, PointList *point_list);
 void destroyPoint(Point *p, PointList *point_list, EdgeList *edge_list);
@@ -14,21 +16,29 @@ void freePoints(PointList *point_list);
 /* Edge functions
  */
 
+void borrowEdgeList(EdgeList *edge_list, EdgeList *parent);
 Edge *getEdge(EdgeList *edge_list);
 void destroyEdge(Edge *e, EdgeList *edge_list);
+void detachEdge(Edge *e);
 void freeEdge(EdgeList *edge_list, Edge *e);
 void freeEdges(EdgeList *edge_list);
+void fixEdge(Edge *e, EdgeList *edge_list);
+int isFixed(Edge *e, EdgeList *edge_list);
 
 Edge *makeEdge(Point *orig, Point *dest, EdgeList *edge_list);
 void weld(Edge *in, Edge *out);
 Edge *bridge(Edge *in, Edge *out, EdgeList *edge_list);
+Edge *ringSuccessor(Point *a, Point *b);
+Edge *insertEdge(Point *a, Point *b, EdgeList *edge_list);
 
 /* Miscellaneous
  */
 
 int onConvexHull(Point *p);
-VALUE orientation(Point *a, Point *b, Point *c);
-VALUE inCircle(Point *a, Point *b, Point *c, Point *d);
+int isTriangle(Edge *e);
+int orientation(Point *a, Point *b, Point *c);
+int inCircle(Point *a, Point *b, Point *c, Point *d);
+int cocircular(Point *a, Point *b, Point *c, Point *d);
 
 
 #endif
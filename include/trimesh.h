@@ -0,0 +1,16 @@
+#ifndef TRIMESH_H
+#define TRIMESH_H
+
+#include "defs.h"
+
+/* Triangle-based backend
+ */
+TriangleList *initializeTriangleList(size_t num_points);
+void freeTriangles(TriangleList *triangle_list);
+int makeTriangle(int a, int b, int c, TriangleList *triangle_list);
+void replaceNeighbour(Triangle *triangles, int t, int old, int new);
+
+TriangleList *triangulateTriangles(Point *points, size_t num_points, int **chain, size_t *chain_size);
+void showTriangleEdges(TriangleList *triangle_list, PointList *point_list, int *chain, size_t chain_size);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "defs.h"
+
+/* What verifyTriangulation counted and found
+ */
+typedef struct
+{
+    size_t vertices;
+    size_t edges;
+    size_t triangles;
+    size_t hull_edges;    // half-edges of the outer face
+    size_t bad_links;     // twin, dnext or oprev out of step
+    size_t not_delaunay;  // interior edges with the far apex in circle
+    size_t bad_hull;      // reflex hull turns, or onConvexHull wrong
+    int euler;            // V - E + F = 2, the outer face one cycle
+} Verification;
+
+int verifyTriangulation(Point *point_list[], size_t num_points, EdgeList *edge_list, Verification *v);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "batch.h"
+#include "helper.h"
+#include "io.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Batch mode: many tiles per process.
+ *
+ * The manifest has one tile per line, an input
+ * point list and the file its edges go to, separated
+ * by whitespace. Each tile is a task of one team, so
+ * small tiles keep every thread busy on their own
+ * and the halves of large ones are picked up by idle
+ * threads (see recurse in delaunay.c). The thread
+ * that starts a tile keeps its point and edge arenas
+ * in its own workspace, reused by its next tile.
+ * Tied tasks only switch to their own descendants,
+ * so a thread never starts a second tile while one
+ * of its tiles is still waiting on its halves.
+ *
+ * Built once, outside the two coordinate widths
+ */
+
+#define MANIFEST_LINE_SIZE 8192
+
+typedef struct
+{
+    char *input;
+    char *output;
+} Tile;
+
+typedef struct
+{
+    Workspace *narrow;
+    Workspace *wide;
+} Worker;
+
+static char *copyString(const char *s)
+{
+    char *copy = malloc(strlen(s) + 1);
+    strcpy(copy, s);
+    return copy;
+}
+
+static Tile *readManifest(const char *filename, size_t *num_tiles)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    size_t size = 0;
+    size_t cap = 64;
+    Tile *tiles = malloc(cap * sizeof *tiles);
+
+    char line[MANIFEST_LINE_SIZE];
+    char input[MANIFEST_LINE_SIZE];
+    char output[MANIFEST_LINE_SIZE];
+    while (fgets(line, MANIFEST_LINE_SIZE, fptr))
+    {
+        int fields = sscanf(line, "%8191s %8191s", input, output);
+        if (fields <= 0) continue;
+        if (fields == 1)
+        {
+            printf("No output file for %s in %s\nExiting...\n", input, filename);
+            exit(1);
+        }
+
+        if (size == cap)
+        {
+            cap *= 2;
+            tiles = realloc(tiles, cap * sizeof *tiles);
+        }
+        tiles[size].input = copyString(input);
+        tiles[size].output = copyString(output);
+        size++;
+    }
+    fclose(fptr);
+
+    *num_tiles = size;
+    return tiles;
+}
+
+static void runTile(const Tile *tile, Worker *worker)
+{
+    size_t num_points;
+    long max_abs;
+    long *xy = readCoordinates(tile->input, &num_points, &max_abs);
+
+    FILE *out = fopen(tile->output, "w");
+    if (out == NULL)
+    {
+        printf("Failed to open %s\n", tile->output);
+        exit(1);
+    }
+
+    if (max_abs < NARROW_COORD_LIMIT) runTileNarrow(xy, num_points, out, &worker->narrow);
+    else runTileWide(xy, num_points, out, &worker->wide);
+
+    fclose(out);
+}
+
+void runBatch(const char *manifest, const Options *options)
+{
+#ifdef _OPENMP
+    if (options->threads > 0) omp_set_num_threads(options->threads);
+#endif
+
+    size_t num_tiles;
+    Tile *tiles = readManifest(manifest, &num_tiles);
+
+    double start = seconds();
+
+    Worker *workers = NULL;
+    size_t num_workers = 0;
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        num_workers = (size_t)teamSize();
+        workers = calloc(num_workers, sizeof *workers);
+
+        for (size_t t = 0; t < num_tiles; t++)
+        {
+            #pragma omp task firstprivate(t)
+            runTile(tiles + t, workers + threadIndex());
+        }
+    }
+
+    if (options->timing) fprintf(stderr, "batch: %zu tiles in %.3f s\n", num_tiles, seconds() - start);
+
+    for (size_t w = 0; w < num_workers; w++)
+    {
+        freeWorkspaceNarrow(workers[w].narrow);
+        freeWorkspaceWide(workers[w].wide);
+    }
+    free(workers);
+
+    for (size_t t = 0; t < num_tiles; t++)
+    {
+        free(tiles[t].input);
+        free(tiles[t].output);
+    }
+    free(tiles);
+}
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "constrain.h"
+#include "topology.h"
+#include "helper.h"
+
+/* Inserting constrained edges (breaklines) into a
+ * finished Delaunay triangulation.
+ *
+ * A segment a -> b is walked from a through the
+ * triangles it crosses, collecting the crossed edges.
+ * Their endpoints left and right of the segment form
+ * two chains ('pseudo-polygons') which, once the
+ * crossed edges are deleted and a -> b inserted, are
+ * filled again with triangles whose circles hold no
+ * other chain vertex (Anglada). The result is the
+ * constrained Delaunay triangulation: every edge not
+ * fixed is locally Delaunay.
+ *
+ * A segment through other points is inserted piece by
+ * piece between them. The pieces are flagged as fixed
+ * in the edge list, and merges never delete a fixed
+ * edge. Segments that cross are rejected
+ */
+
+typedef struct
+{
+    Edge **data;
+    size_t size;
+    size_t cap;
+} EdgeStack;
+
+typedef struct
+{
+    Point **data;
+    size_t size;
+    size_t cap;
+} Chain;
+
+static void pushEdge(EdgeStack *s, Edge *e)
+{
+    if (s->size == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 64;
+        s->data = realloc(s->data, s->cap * sizeof *(s->data));
+    }
+    (s->data)[(s->size)++] = e;
+}
+
+static void pushPoint(Chain *s, Point *p)
+{
+    if (s->size == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 64;
+        s->data = realloc(s->data, s->cap * sizeof *(s->data));
+    }
+    (s->data)[(s->size)++] = p;
+}
+
+/* The edge out of a towards a point c on the
+ * ray from a through b, or NULL
+ */
+static Edge *edgeAlong(Point *a, Point *b)
+{
+    int forward = compareXY(a, b);
+    Edge *e = a->e;
+    Edge *f = e;
+    do
+    {
+        Point *c = f->twin->orig;
+        if (orientation(a, b, c) == 0 && compareXY(a, c) == forward) return f;
+        f = f->twin->dnext;
+    } while (f != e);
+
+    return NULL;
+}
+
+/* Fill the pseudo-polygon of chain[0 .. size - 1]
+ * (the segment ends first and last, the vertices
+ * in between in order along it, all on one side)
+ * with Delaunay triangles. The chain is split at
+ * the vertex whose circle with the ends holds no
+ * other vertex, without recursion
+ */
+static void fillChain(Point **chain, size_t size, EdgeList *edge_list)
+{
+    size_t *ranges = malloc(2 * size * sizeof *ranges);
+    size_t num_ranges = 0;
+
+    ranges[num_ranges++] = 0;
+    ranges[num_ranges++] = size - 1;
+    while (num_ranges > 0)
+    {
+        size_t j = ranges[--num_ranges];
+        size_t i = ranges[--num_ranges];
+        if (j - i < 2) continue;
+
+        // Vertices in line with a and b make no triangle
+        Point *a = chain[i];
+        Point *b = chain[j];
+        size_t k = i + 1;
+        while (k < j - 1 && orientation(a, b, chain[k]) == 0) k++;
+        int side = orientation(a, b, chain[k]);
+        for (size_t m = k + 1; m < j; m++)
+        {
+            if (orientation(a, b, chain[m]) != side) continue;
+            Point *c = chain[k];
+            int sign = (side > 0) ? inCircle(a, b, c, chain[m]) : inCircle(b, a, c, chain[m]);
+            if (sign > 0) k = m;
+        }
+
+        if (k > i + 1) insertEdge(a, chain[k], edge_list);
+        if (k < j - 1) insertEdge(chain[k], b, edge_list);
+
+        ranges[num_ranges++] = i;
+        ranges[num_ranges++] = k;
+        ranges[num_ranges++] = k;
+        ranges[num_ranges++] = j;
+    }
+
+    free(ranges);
+}
+
+/* Replace the edges crossed by the segment from a
+ * up to the first point c it meets, by a -> c and
+ * the fill of the chains either side. Returns c
+ */
+static Point *insertPiece(Point *a, Point *b, EdgeStack *crossed, Chain *left, Chain *right, EdgeList *edge_list)
+{
+    crossed->size = left->size = right->size = 0;
+
+    // The triangle at a in the direction of b,
+    // and its side opposite a
+    Edge *h = ringSuccessor(a, b)->dnext;
+    Point *c;
+    while (1)
+    {
+        if (isFixed(h, edge_list))
+        {
+            printf("Constrained edges cross\nExiting...\n");
+            exit(1);
+        }
+        pushEdge(crossed, h);
+
+        Edge *t = h->twin;
+        Point *w = t->dnext->twin->orig;
+        if (w == b || orientation(a, b, w) == 0)
+        {
+            c = w;
+            break;
+        }
+
+        if (orientation(a, b, w) == orientation(a, b, h->orig)) h = t->dnext->dnext;
+        else h = t->dnext;
+    }
+
+    pushPoint(left, a);
+    pushPoint(right, a);
+    for (size_t t = 0; t < crossed->size; t++)
+    {
+        Edge *e = (crossed->data)[t];
+        Point *l = e->orig;
+        Point *r = e->twin->orig;
+        if (orientation(a, c, l) < 0)
+        {
+            l = r;
+            r = e->orig;
+        }
+        if ((left->data)[left->size - 1] != l) pushPoint(left, l);
+        if ((right->data)[right->size - 1] != r) pushPoint(right, r);
+    }
+    pushPoint(left, c);
+    pushPoint(right, c);
+
+    for (size_t t = 0; t < crossed->size; t++) destroyEdge((crossed->data)[t], edge_list);
+
+    fixEdge(insertEdge(a, c, edge_list), edge_list);
+    fillChain(left->data, left->size, edge_list);
+    fillChain(right->data, right->size, edge_list);
+
+    return c;
+}
+
+/* Make the segment from a to b part of the
+ * triangulation, as one or more fixed edges
+ */
+void insertSegment(Point *a, Point *b, EdgeList *edge_list)
+{
+    EdgeStack crossed = {NULL, 0, 0};
+    Chain left = {NULL, 0, 0};
+    Chain right = {NULL, 0, 0};
+
+    while (a != b)
+    {
+        Edge *e = edgeAlong(a, b);
+        if (e)
+        {
+            fixEdge(e, edge_list);
+            a = e->twin->orig;
+        }
+        else a = insertPiece(a, b, &crossed, &left, &right, edge_list);
+    }
+
+    free(crossed.data);
+    free(left.data);
+    free(right.data);
+}
+
+/* Insert the segments between points[segments[2i]]
+ * and points[segments[2i + 1]], one after another
+ */
+void insertSegments(Point *points, const size_t *segments, size_t num_segments, EdgeList *edge_list)
+{
+    for (size_t t = 0; t < num_segments; t++)
+    {
+        Point *a = points + segments[2 * t];
+        Point *b = points + segments[2 * t + 1];
+        if (a->e == NULL || b->e == NULL) continue;
+        insertSegment(a, b, edge_list);
+    }
+}
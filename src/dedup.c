@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "dedup.h"
+
+/* Duplicate removal.
+ *
+ * Two points at the same place have no Delaunay
+ * triangulation, so only the first of each is given
+ * to the backends. Points are inserted into an open
+ * addressing hash table by all threads at once: a
+ * slot holds the index of a point, and a point equal
+ * to the one in its slot replaces it (by compare and
+ * swap) if its index is lower. Once every point is
+ * in, the slot of each point holds the first of its
+ * duplicates whatever the order of the inserts, and
+ * a second pass looks each point up.
+ */
+
+#define EMPTY_SLOT SIZE_MAX
+
+typedef struct
+{
+    Point *points;
+    _Atomic size_t *slots;
+    size_t mask;
+    int shift;
+} Table;
+
+static size_t hashPoint(const Table *table, const Point *p)
+{
+    uint64_t h = (uint64_t)p->x * 0x9E3779B97F4A7C15u ^ (uint64_t)p->y * 0xC2B2AE3D27D4EB4Fu;
+    return (size_t)((h * 0x9E3779B97F4A7C15u) >> table->shift);
+}
+
+static int samePoint(const Point *a, const Point *b)
+{
+    return a->x == b->x && a->y == b->y;
+}
+
+static void insertPoint(Table *table, size_t t)
+{
+    Point *p = table->points + t;
+    size_t s = hashPoint(table, p);
+    while (1)
+    {
+        size_t cur = atomic_load(table->slots + s);
+        if (cur == EMPTY_SLOT)
+        {
+            if (atomic_compare_exchange_weak(table->slots + s, &cur, t)) return;
+            continue;
+        }
+        if (samePoint(table->points + cur, p))
+        {
+            if (cur < t || atomic_compare_exchange_weak(table->slots + s, &cur, t)) return;
+            continue;
+        }
+        s = (s + 1) & table->mask;
+    }
+}
+
+static size_t findPoint(const Table *table, size_t t)
+{
+    Point *p = table->points + t;
+    size_t s = hashPoint(table, p);
+    while (!samePoint(table->points + table->slots[s], p)) s = (s + 1) & table->mask;
+    return table->slots[s];
+}
+
+size_t removeDuplicates(Point points[], size_t num_points, Point *unique[], size_t *representative)
+{
+    // At most half full
+    int bits = 1;
+    while (((size_t)1 << bits) < 2 * num_points) bits++;
+
+    Table table;
+    table.points = points;
+    table.mask = ((size_t)1 << bits) - 1;
+    table.shift = 64 - bits;
+    table.slots = malloc((table.mask + 1) * sizeof *(table.slots));
+
+    #pragma omp parallel for schedule(static)
+    for (size_t s = 0; s <= table.mask; s++) atomic_init(table.slots + s, EMPTY_SLOT);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t t = 0; t < num_points; t++) insertPoint(&table, t);
+
+    // A point is kept iff it is the one in its slot
+    char *kept = malloc(num_points);
+    #pragma omp parallel for schedule(static)
+    for (size_t t = 0; t < num_points; t++)
+    {
+        size_t r = findPoint(&table, t);
+        kept[t] = (r == t);
+        if (representative) representative[t] = r;
+    }
+
+    size_t n = 0;
+    for (size_t t = 0; t < num_points; t++)
+    {
+        if (kept[t]) unique[n++] = points + t;
+    }
+
+    free(kept);
+    free(table.slots);
+    return n;
+}
@@ -2,29 +2,164 @@
 #include "delaunay.h"
 #include "topology.h"
 #include "helper.h"
+#include "seam.h"
+#include "stream.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// Halves smaller than this are triangulated
+// by the thread that reached them
+#define PARALLEL_MIN_POINTS (1 << 14)
+
+// Halves of at most this many points (whose parent
+// has more) are streamed as blocks, see stream.c
+#define STREAM_BLOCK_POINTS (1 << 13)
+
+/* Where the points of a call lie, when its
+ * edges are streamed out
+ */
+typedef struct
+{
+    Stream *stream;
+    Cell cell;
+} Region;
+
+typedef ExtremeEdge *(*Triangulate)(Point *[], size_t, EdgeList *, const Region *);
+
+static ExtremeEdge *horizontal(Point *point_list[], size_t num_points, EdgeList *edge_list, const Region *region);
+static ExtremeEdge *vertical(Point *point_list[], size_t num_points, EdgeList *edge_list, const Region *region);
+
+/* Number of edges in triangulated graph is < 3*V
+ * and we store edge and its twin -> 6*V.
+ * A seam zipped in pieces (see seam.c) briefly
+ * holds a few more, so leave V/16 spare
+ */
+size_t edgeCapacity(size_t num_points)
+{
+    return 6 * num_points + num_points / 16;
+}
 
 EdgeList *initializeEdgeList(size_t num_points)
 {
     EdgeList *edge_list = malloc(sizeof *edge_list);
 
-    // Number of edges in triangulated graph is < 3*V
-    // and we store edge and its twin -> 6*V
-    edge_list->edges = malloc(6 * num_points * sizeof(*(edge_list->edges)));
-    edge_list->unused_edges = malloc(6 * num_points * sizeof(*(edge_list->unused_edges)));
-    for (size_t t = 0; t < 6 * num_points; t++) (edge_list->unused_edges)[t] = edge_list->edges + t;
-
-    edge_list->idx = 6 * num_points;
-    edge_list->size = 6 * num_points;
+    size_t capacity = edgeCapacity(num_points);
+    edge_list->edges = malloc(capacity * sizeof(*(edge_list->edges)));
+    edge_list->unused_edges = malloc(capacity * sizeof(*(edge_list->unused_edges)));
+    edge_list->fixed = NULL;
+    resetEdgeList(edge_list, num_points);
 
     return edge_list;
 }
 
-ExtremeEdge *delaunay2(Point *point_list[], EdgeList *edge_list)
+/* Mark the edges for num_points of a list
+ * initialized for at least that many as unused,
+ * so its memory can be used for a new point set
+ */
+void resetEdgeList(EdgeList *edge_list, size_t num_points)
 {
-    ExtremeEdge *ex = malloc(sizeof *ex);
+    size_t capacity = edgeCapacity(num_points);
+    for (size_t t = 0; t < capacity; t++) (edge_list->unused_edges)[t] = edge_list->edges + t;
+
+    edge_list->idx = capacity;
+    edge_list->size = capacity;
+    edge_list->parent = NULL;
+    if (edge_list->fixed) memset(edge_list->fixed, 0, capacity);
+}
+
+/* Hand each half its own slice of the unused
+ * edges of a fresh list, sized as in
+ * initializeEdgeList, so that both halves can be
+ * triangulated at once without sharing a stack
+ */
+void splitEdgeList(EdgeList *edge_list, size_t num_first, size_t num_second, EdgeList *first, EdgeList *second)
+{
+    first->edges = second->edges = edge_list->edges;
+    first->parent = second->parent = NULL;
+    first->fixed = second->fixed = edge_list->fixed;
+
+    first->unused_edges = edge_list->unused_edges;
+    first->idx = first->size = edgeCapacity(num_first);
+
+    second->unused_edges = edge_list->unused_edges + first->size;
+    second->idx = second->size = edgeCapacity(num_second);
+}
+
+/* Gather the edges left unused by both halves
+ * (and any beyond their slices) back into one stack
+ */
+void joinEdgeLists(EdgeList *edge_list, EdgeList *first, EdgeList *second)
+{
+    size_t sliced = first->size + second->size;
+    size_t rest = edge_list->idx - sliced;
+
+    memmove(edge_list->unused_edges + first->idx, second->unused_edges, second->idx * sizeof *(edge_list->unused_edges));
+    memmove(edge_list->unused_edges + first->idx + second->idx, edge_list->unused_edges + sliced, rest * sizeof *(edge_list->unused_edges));
+
+    edge_list->idx = first->idx + second->idx + rest;
+}
+
+/* Regions of the two halves of a call cut at
+ * split, across x (or y if vertical)
+ */
+static void splitRegion(const Region *region, Point *split, int vertical, Region halves[2])
+{
+    halves[0] = halves[1] = *region;
+    if (vertical) halves[0].cell.y_hi = halves[1].cell.y_lo = split->y;
+    else halves[0].cell.x_hi = halves[1].cell.x_lo = split->x;
+}
+
+/* Triangulate one half, streaming its final
+ * edges if it is a block
+ */
+static ExtremeEdge *half(Triangulate triangulate, Point *point_list[], size_t num_points, size_t parent_points,
+                         const Region *region, EdgeList *edge_list)
+{
+    ExtremeEdge *ex = triangulate(point_list, num_points, edge_list, region);
+    if (region && num_points <= STREAM_BLOCK_POINTS && parent_points > STREAM_BLOCK_POINTS)
+    {
+        streamBlock(region->stream, point_list, num_points, &region->cell);
+    }
+    return ex;
+}
+
+/* Triangulate point_list[0, median) and
+ * point_list[median, num_points) with triangulate,
+ * as two tasks when the halves are large.
+ * halves is NULL unless edges are streamed
+ */
+static void recurse(Point *point_list[], size_t num_points, size_t median, Triangulate triangulate,
+                    const Region *halves, ExtremeEdge **first_ex, ExtremeEdge **second_ex, EdgeList *edge_list)
+{
+    const Region *first = halves;
+    const Region *second = halves ? halves + 1 : NULL;
+
+    if (num_points < PARALLEL_MIN_POINTS || teamSize() == 1 || edge_list->idx < edgeCapacity(num_points))
+    {
+        *first_ex = half(triangulate, point_list, median, num_points, first, edge_list);
+        *second_ex = half(triangulate, point_list + median, num_points - median, num_points, second, edge_list);
+        return;
+    }
+
+    EdgeList first_list;
+    EdgeList second_list;
+    splitEdgeList(edge_list, median, num_points - median, &first_list, &second_list);
+
+    #pragma omp task shared(first_list)
+    *first_ex = half(triangulate, point_list, median, num_points, first, &first_list);
+    *second_ex = half(triangulate, point_list + median, num_points - median, num_points, second, &second_list);
+    #pragma omp taskwait
 
+    joinEdgeLists(edge_list, &first_list, &second_list);
+}
+
+/* Base cases fill in ex, so that callers can
+ * keep extreme edges wherever suits them
+ */
+void delaunay2(Point *point_list[], EdgeList *edge_list, ExtremeEdge *ex)
+{
     Point *a = point_list[0];
     Point *b = point_list[1];
 
@@ -51,14 +186,10 @@ ExtremeEdge *delaunay2(Point *point_list[], EdgeList *edge_list)
         ex->bottom_edge_ccw = e->twin;
         ex->top_edge_cw = e;
     }
-
-    return ex;
 }
 
-ExtremeEdge *delaunay3(Point *point_list[], EdgeList *edge_list)
+void delaunay3(Point *point_list[], EdgeList *edge_list, ExtremeEdge *ex)
 {
-    ExtremeEdge *ex = malloc(sizeof *ex);
-
     // Sort lexicographically by (x, y)
     quickselect(point_list, 0, 2, 1, compareXY);
 
@@ -74,7 +205,7 @@ ExtremeEdge *delaunay3(Point *point_list[], EdgeList *edge_list)
     // Check triangle orientation and
     // bridge over last edge, if necessary
     Edge *e3;
-    VALUE signed_area = orientation(a, b, c);
+    int signed_area = orientation(a, b, c);
     if (signed_area > 0) // a -> b -> c -> a is a counterclockwise-oriented triangle
     {
         e3 = bridge(e2, e1, edge_list);
@@ -113,11 +244,33 @@ ExtremeEdge *delaunay3(Point *point_list[], EdgeList *edge_list)
         ex->bottom_edge_ccw = e3->twin;
         ex->top_edge_cw = e3;
     }
+}
+
+ExtremeEdge *delaunay_horizontal(Point *point_list[], size_t num_points, EdgeList *edge_list)
+{
+    return horizontal(point_list, num_points, edge_list, NULL);
+}
+
+ExtremeEdge *delaunay_vertical(Point *point_list[], size_t num_points, EdgeList *edge_list)
+{
+    return vertical(point_list, num_points, edge_list, NULL);
+}
+
+/* As delaunay_horizontal, but edges known to be final
+ * are written to stream while merges are still going on.
+ * closeStream writes the rest
+ */
+ExtremeEdge *delaunayStreamed(Point *point_list[], size_t num_points, EdgeList *edge_list, Stream *stream)
+{
+    Region region = {stream, {-HUGE_VALL, HUGE_VALL, -HUGE_VALL, HUGE_VALL}};
+
+    ExtremeEdge *ex = horizontal(point_list, num_points, edge_list, &region);
+    if (num_points <= STREAM_BLOCK_POINTS) streamBlock(stream, point_list, num_points, &region.cell);
 
     return ex;
 }
 
-ExtremeEdge *delaunay_horizontal(Point *point_list[], size_t num_points, EdgeList *edge_list)
+static ExtremeEdge *horizontal(Point *point_list[], size_t num_points, EdgeList *edge_list, const Region *region)
 {
     //printf("called horizontal\n");
     // BASE CASES
@@ -126,26 +279,85 @@ ExtremeEdge *delaunay_horizontal(Point *point_list[], size_t num_points, EdgeLis
         printf("Something has gone very wrong.\nTrying to triangulate fewer than 2 points.\nExiting...\n");
         exit(1);
     }
-    else if (num_points == 2)
+    else if (num_points <= 3)
+    {
+        ExtremeEdge *ex = malloc(sizeof *ex);
+        if (num_points == 2) delaunay2(point_list, edge_list, ex);
+        else delaunay3(point_list, edge_list, ex);
+        return ex;
+    }
+
+    // RECURSION CASE
+    // Divide
+    size_t median = num_points / 2;
+    quickselect(point_list, 0, num_points - 1, median, compareXY);
+    Point *split = point_list[median];
+
+    // Recurse
+    Region halves[2];
+    if (region) splitRegion(region, split, 0, halves);
+
+    ExtremeEdge *left_ex;
+    ExtremeEdge *right_ex;
+    recurse(point_list, num_points, median, vertical, region ? halves : NULL, &left_ex, &right_ex, edge_list);
+
+    ExtremeEdge *ex = malloc(sizeof *ex);
+    mergeHorizontal(left_ex, right_ex, split, num_points, edge_list, ex);
+
+    free(left_ex);
+    free(right_ex);
+
+    return ex;
+}
+
+static ExtremeEdge *vertical(Point *point_list[], size_t num_points, EdgeList *edge_list, const Region *region)
+{
+    //printf("called vertical\n");
+    // BASE CASES
+    if (num_points < 2)
     {
-        return delaunay2(point_list, edge_list);
+        printf("Something has gone very wrong.\nTrying to triangulate fewer than 2 points.\nExiting...\n");
+        exit(1);
     }
-    else if (num_points == 3)
+    else if (num_points <= 3)
     {
-        return delaunay3(point_list, edge_list);
+        ExtremeEdge *ex = malloc(sizeof *ex);
+        if (num_points == 2) delaunay2(point_list, edge_list, ex);
+        else delaunay3(point_list, edge_list, ex);
+        return ex;
     }
 
     // RECURSION CASE
     // Divide
     size_t median = num_points / 2;
-    quickselect(point_list, 0, num_points - 1, median, compareXY);
+    quickselect(point_list, 0, num_points - 1, median, compareYX);
+    Point *split = point_list[median];
 
     // Recurse
-    ExtremeEdge *left_ex = delaunay_vertical(point_list, median, edge_list);
-    ExtremeEdge *right_ex = delaunay_vertical(point_list + median, num_points - median, edge_list);
+    Region halves[2];
+    if (region) splitRegion(region, split, 1, halves);
+
+    ExtremeEdge *bottom_ex;
+    ExtremeEdge *top_ex;
+    recurse(point_list, num_points, median, horizontal, region ? halves : NULL, &bottom_ex, &top_ex, edge_list);
 
     ExtremeEdge *ex = malloc(sizeof *ex);
+    mergeVertical(bottom_ex, top_ex, split, num_points, edge_list, ex);
+
+    free(bottom_ex);
+    free(top_ex);
 
+    return ex;
+}
+
+/* Merge the triangulations of the points left and
+ * right of split (the least point of the right half)
+ * into ex, updating the extreme edges of both halves
+ * on the way
+ */
+void mergeHorizontal(ExtremeEdge *left_ex, ExtremeEdge *right_ex, Point *split,
+                     size_t num_points, EdgeList *edge_list, ExtremeEdge *ex)
+{
     // Merge
     Edge *left_edge = left_ex->right_edge_cw;
     Edge *right_edge = right_ex->left_edge_ccw;
@@ -167,13 +379,7 @@ ExtremeEdge *delaunay_horizontal(Point *point_list[], size_t num_points, EdgeLis
     if (right_edge->orig == right_ex->right_edge_cw->orig) right_ex->right_edge_cw = lct;
 
     // Add crossing edges upwards from the lower common tangent
-    Edge *new_base = lct;
-    Edge *uct = NULL;
-    while (new_base != NULL)
-    {
-        uct = new_base; 
-        new_base = nextCrossEdge(uct, edge_list);
-    }
+    Edge *uct = zipSeam(lct, left_ex, right_ex, split, 0, num_points, edge_list);
 
     // Select extreme edges for complete convex hull
     ex->left_edge_ccw = left_ex->left_edge_ccw;
@@ -190,42 +396,14 @@ ExtremeEdge *delaunay_horizontal(Point *point_list[], size_t num_points, EdgeLis
     temp = temp->twin->oprev->twin;
     while (compareYX(temp->orig, temp->twin->orig)) temp = temp->twin->oprev->twin;
     ex->top_edge_cw = temp;
-
-    free(left_ex);
-    free(right_ex);
-
-    return ex;
 }
 
-ExtremeEdge *delaunay_vertical(Point *point_list[], size_t num_points, EdgeList *edge_list)
+/* As mergeHorizontal, for the points below and
+ * above split (the least point of the top half)
+ */
+void mergeVertical(ExtremeEdge *bottom_ex, ExtremeEdge *top_ex, Point *split,
+                   size_t num_points, EdgeList *edge_list, ExtremeEdge *ex)
 {
-    //printf("called vertical\n");
-    // BASE CASES
-    if (num_points < 2)
-    {
-        printf("Something has gone very wrong.\nTrying to triangulate fewer than 2 points.\nExiting...\n");
-        exit(1);
-    }
-    else if (num_points == 2)
-    {
-        return delaunay2(point_list, edge_list);
-    }
-    else if (num_points == 3)
-    {
-        return delaunay3(point_list, edge_list);
-    }
-
-    // RECURSION CASE
-    // Divide
-    size_t median = num_points / 2;
-    quickselect(point_list, 0, num_points - 1, median, compareYX);
-
-    // Recurse
-    ExtremeEdge *bottom_ex = delaunay_horizontal(point_list, median, edge_list);
-    ExtremeEdge *top_ex = delaunay_horizontal(point_list + median, num_points - median, edge_list);
-    
-    ExtremeEdge *ex = malloc(sizeof *ex);
-
     // Merge
     Edge *bottom_edge = bottom_ex->top_edge_cw;
     Edge *top_edge = top_ex->bottom_edge_ccw;
@@ -247,13 +425,7 @@ ExtremeEdge *delaunay_vertical(Point *point_list[], size_t num_points, EdgeList
     if (top_edge->orig == top_ex->top_edge_cw->orig) top_ex->top_edge_cw = rct;
 
     // Add crossing edges upwards from the lower common tangent
-    Edge *new_base = rct;
-    Edge *lct = NULL;
-    while (new_base != NULL)
-    {
-        lct = new_base;
-        new_base = nextCrossEdge(lct, edge_list);
-    }
+    Edge *lct = zipSeam(rct, bottom_ex, top_ex, split, 1, num_points, edge_list);
 
     // Select extreme edges for complete convex hull
     ex->bottom_edge_ccw = bottom_ex->bottom_edge_ccw;
@@ -270,11 +442,6 @@ ExtremeEdge *delaunay_vertical(Point *point_list[], size_t num_points, EdgeList
     temp = temp->dnext;
     while (compareXY(temp->twin->orig, temp->orig)) temp = temp->dnext;
     ex->left_edge_ccw = temp;
-
-    free(bottom_ex);
-    free(top_ex);
-
-    return ex;
 }
 
 /* Base is assumed to be an R-L edge
@@ -284,12 +451,25 @@ ExtremeEdge *delaunay_vertical(Point *point_list[], size_t num_points, EdgeList
  */
 Edge *nextCrossEdge(Edge *base, EdgeList *edge_list)
 {
+    return nextCrossEdgeBefore(base, NULL, edge_list);
+}
+
+/* As nextCrossEdge, but stop is an R-L crossing
+ * edge further up that is already in the graph
+ * (or NULL). Returns NULL instead of reaching it,
+ * never rotating past it about its endpoints
+ */
+Edge *nextCrossEdgeBefore(Edge *base, Edge *stop, EdgeList *edge_list)
+{
+    Edge *stop_l = stop ? stop->twin : NULL;
+
     Edge *l_cand = base->dnext;
-    VALUE valid_l = orientation(base->orig, l_cand->orig, l_cand->twin->orig) < 0;
+    int valid_l = (l_cand != stop_l) && (orientation(base->orig, l_cand->orig, l_cand->twin->orig) < 0);
     if (valid_l)
     {
         Edge *next_cand = l_cand->twin->dnext;
-        while (inCircle(l_cand->orig, base->orig, l_cand->twin->orig, next_cand->twin->orig) > 0)
+        while (next_cand != stop_l && !isFixed(l_cand, edge_list) &&
+               inCircle(l_cand->orig, base->orig, l_cand->twin->orig, next_cand->twin->orig) > 0)
         {
             destroyEdge(l_cand, edge_list);
             l_cand = next_cand;
@@ -298,11 +478,12 @@ Edge *nextCrossEdge(Edge *base, EdgeList *edge_list)
     }
 
     Edge *r_cand = base->oprev->twin;
-    VALUE valid_r = orientation(base->twin->orig, base->orig, r_cand->twin->orig) > 0;
+    int valid_r = (r_cand != stop) && (orientation(base->twin->orig, base->orig, r_cand->twin->orig) > 0);
     if (valid_r)
     {
         Edge *next_cand = r_cand->oprev->twin;
-        while (inCircle(base->twin->orig, base->orig, r_cand->twin->orig, next_cand->twin->orig) > 0)
+        while (next_cand != stop && !isFixed(r_cand, edge_list) &&
+               inCircle(base->twin->orig, base->orig, r_cand->twin->orig, next_cand->twin->orig) > 0)
         {
             destroyEdge(r_cand, edge_list);
             r_cand = next_cand;
@@ -311,8 +492,16 @@ Edge *nextCrossEdge(Edge *base, EdgeList *edge_list)
     }
 
     if (!valid_l && !valid_r) return NULL;
-    else if (!valid_l || (valid_r && (inCircle(l_cand->twin->orig, l_cand->orig, r_cand->orig, r_cand->twin->orig) > 0))) return bridge(base, r_cand->twin, edge_list)->twin;
-    else return bridge(l_cand, base, edge_list)->twin;
+    else if (!valid_l || (valid_r && (inCircle(l_cand->twin->orig, l_cand->orig, r_cand->orig, r_cand->twin->orig) > 0)))
+    {
+        if (stop && stop->orig == r_cand->twin->orig && stop_l->orig == base->twin->orig) return NULL;
+        return bridge(base, r_cand->twin, edge_list)->twin;
+    }
+    else
+    {
+        if (stop && stop->orig == base->orig && stop_l->orig == l_cand->twin->orig) return NULL;
+        return bridge(l_cand, base, edge_list)->twin;
+    }
 }
 
 void deleteAndTriangulate(Point *p, PointList *point_list, EdgeList *edge_list)
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include "filter.h"
+#include "topology.h"
+#include "helper.h"
+#include "io.h"
+
+/* Filtered output.
+ *
+ * Only triangles passing the filter are kept, and
+ * only edges with a kept triangle on either side are
+ * written, in the format of showEdges. Half-edges
+ * with a kept triangle on their right and anything
+ * else on their left bound the kept region; they are
+ * chained into closed polygons by turning about each
+ * end to the next such half-edge. With the kept
+ * region on the right, outer boundaries run clockwise
+ * and the boundaries of holes counter-clockwise.
+ */
+
+static long double length2(Point *a, Point *b)
+{
+    long double dx = (long double)a->x - b->x;
+    long double dy = (long double)a->y - b->y;
+    return dx * dx + dy * dy;
+}
+
+/* Whether the face right of e is a kept triangle.
+ * The circumradius of a triangle with sides a, b, c
+ * is abc / (2 |cross|), cross being twice its area
+ */
+static int faceKept(Edge *e, const Filter *filter)
+{
+    if (!isTriangle(e)) return 0;
+
+    Point *a = e->orig;
+    Point *b = e->dnext->orig;
+    Point *c = e->dnext->dnext->orig;
+    long double ab = length2(a, b);
+    long double bc = length2(b, c);
+    long double ca = length2(c, a);
+
+    if (filter->max_edge > 0)
+    {
+        long double bound = (long double)filter->max_edge * filter->max_edge;
+        if (ab > bound || bc > bound || ca > bound) return 0;
+    }
+
+    if (filter->alpha > 0)
+    {
+        long double cross = ((long double)b->x - a->x) * ((long double)c->y - a->y) -
+                            ((long double)b->y - a->y) * ((long double)c->x - a->x);
+        long double bound = (long double)filter->alpha * filter->alpha;
+        if (ab * bc * ca > 4 * bound * cross * cross) return 0;
+    }
+
+    return 1;
+}
+
+static void writePoint(FILE *out, PointList *point_list, Point *p)
+{
+    char text[POINT_TEXT_MAX];
+    fwrite(text, 1, formatPoint(text, point_list, p), out);
+}
+
+/* Write each boundary polygon on its own line,
+ * as its vertices in order
+ */
+static void writeBoundary(PointList *point_list, EdgeList *edge_list, const Filter *filter,
+                          Edge **boundary, size_t num_boundary, FILE *out)
+{
+    char *visited = calloc(edge_list->size, sizeof *visited);
+
+    for (size_t t = 0; t < num_boundary; t++)
+    {
+        Edge *b = boundary[t];
+        if (visited[b - edge_list->edges]) continue;
+
+        writePoint(out, point_list, b->orig);
+        while (1)
+        {
+            visited[b - edge_list->edges] = 1;
+
+            // Turn counter-clockwise about the end of b,
+            // through kept triangles, to the next edge
+            // leaving the kept region on its left
+            Edge *f = b->dnext;
+            while (faceKept(f->twin, filter)) f = f->twin->dnext;
+
+            b = f;
+            if (visited[b - edge_list->edges]) break;
+
+            fprintf(out, " ");
+            writePoint(out, point_list, b->orig);
+        }
+        fprintf(out, "\n");
+    }
+
+    free(visited);
+}
+
+/* Write the edges of the triangles kept by filter
+ * to out and, if boundary_out is not NULL, the
+ * boundary polygons of the kept region to it
+ */
+void writeFilteredEdges(PointList *point_list, EdgeList *edge_list, const Filter *filter,
+                        FILE *out, FILE *boundary_out)
+{
+    size_t num_boundary = 0;
+    size_t cap = 64;
+    Edge **boundary = malloc(cap * sizeof *boundary);
+
+    for (size_t idx = 0; idx < point_list->size; idx++)
+    {
+        Edge *e = (point_list->points)[idx].e;
+        Edge *f = e;
+
+        if (f == NULL) continue;
+
+        do {
+            f = f->twin->dnext;
+            if (!compareXY(f->orig, f->twin->orig)) continue;
+
+            int right = faceKept(f, filter);
+            int left = faceKept(f->twin, filter);
+            if (!right && !left) continue;
+
+            char text[EDGE_TEXT_MAX];
+            fwrite(text, 1, formatEdge(text, point_list, f), out);
+
+            if (right == left) continue;
+            if (num_boundary == cap)
+            {
+                cap *= 2;
+                boundary = realloc(boundary, cap * sizeof *boundary);
+            }
+            boundary[num_boundary++] = right ? f : f->twin;
+        } while (f != e);
+    }
+
+    if (boundary_out) writeBoundary(point_list, edge_list, filter, boundary, num_boundary, boundary_out);
+
+    free(boundary);
+}
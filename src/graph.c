@@ -0,0 +1,492 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "graph.h"
+#include "helper.h"
+#include "io.h"
+
+/* Euclidean minimum spanning tree and k nearest
+ * neighbours, both found among Delaunay edges.
+ *
+ * The EMST is a subgraph of the Delaunay graph, so
+ * Kruskal's algorithm only needs the live edges of
+ * the edge list. They are sorted by squared length
+ * with a task-parallel merge sort, then taken in
+ * batches: all threads first drop the edges of a
+ * batch whose ends are already joined, with finds
+ * on a union-find that halves paths by compare and
+ * swap, so finds can run side by side without locks.
+ * The few edges left are then joined in order by one
+ * thread. Joined sets only grow, so an edge dropped
+ * against the start of its batch is never needed.
+ *
+ * The i-th nearest neighbour of a point is joined by
+ * a Delaunay edge to the point or to one of its i - 1
+ * nearer neighbours. Taking points best first from
+ * the rings of those found so far (Point.e) therefore
+ * finds the k nearest exactly, after looking at about
+ * 6k points.
+ *
+ * Ties of length are broken by point order, so the
+ * results do not depend on the thread count.
+ */
+
+// Sorts of fewer keys are not split into tasks,
+// and start from insertion sorted runs
+#define SORT_MIN_KEYS (1 << 13)
+#define SORT_RUN_KEYS 16
+
+// Edges filtered by all threads at once
+#define TREE_BATCH_EDGES (1 << 15)
+
+// Slots of the edge list gathered per task
+#define GATHER_SLOTS (1 << 16)
+
+// Squared lengths, exact for the narrow variant
+#ifdef NARROW_COORDS
+typedef unsigned long long LENGTH;
+#else
+typedef long double LENGTH;
+#endif
+
+typedef struct
+{
+    LENGTH length2;
+    Edge *e;
+} Key;
+
+static LENGTH distance2(const Point *a, const Point *b)
+{
+    #ifdef NARROW_COORDS
+    long long dx = (long long)a->x - b->x;
+    long long dy = (long long)a->y - b->y;
+    return (LENGTH)(dx * dx) + (LENGTH)(dy * dy);
+    #else
+    long double dx = (long double)a->x - b->x;
+    long double dy = (long double)a->y - b->y;
+    return dx * dx + dy * dy;
+    #endif
+}
+
+static Point *lower(const Edge *e)
+{
+    return e->orig < e->twin->orig ? e->orig : e->twin->orig;
+}
+
+static Point *upper(const Edge *e)
+{
+    return e->orig < e->twin->orig ? e->twin->orig : e->orig;
+}
+
+static int keyLess(const Key *a, const Key *b)
+{
+    if (a->length2 != b->length2) return a->length2 < b->length2;
+    if (lower(a->e) != lower(b->e)) return lower(a->e) < lower(b->e);
+    return upper(a->e) < upper(b->e);
+}
+
+/***********************************
+ * SORTING *************************
+ ***********************************/
+
+static void mergeKeys(const Key *a, size_t na, const Key *b, size_t nb, Key *out)
+{
+    size_t i = 0, j = 0, m = 0;
+    while (i < na && j < nb) out[m++] = keyLess(b + j, a + i) ? b[j++] : a[i++];
+    while (i < na) out[m++] = a[i++];
+    while (j < nb) out[m++] = b[j++];
+}
+
+/* Insertion sort runs of SORT_RUN_KEYS, then
+ * merge them pairwise, back and forth with tmp
+ */
+static void sortBlock(Key *keys, Key *tmp, size_t n)
+{
+    for (size_t lo = 0; lo < n; lo += SORT_RUN_KEYS)
+    {
+        size_t hi = lo + SORT_RUN_KEYS < n ? lo + SORT_RUN_KEYS : n;
+        for (size_t i = lo + 1; i < hi; i++)
+        {
+            Key key = keys[i];
+            size_t j = i;
+            while (j > lo && keyLess(&key, keys + j - 1))
+            {
+                keys[j] = keys[j - 1];
+                j--;
+            }
+            keys[j] = key;
+        }
+    }
+
+    Key *from = keys;
+    Key *to = tmp;
+    for (size_t width = SORT_RUN_KEYS; width < n; width *= 2)
+    {
+        for (size_t lo = 0; lo < n; lo += 2 * width)
+        {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            mergeKeys(from + lo, mid - lo, from + mid, hi - mid, to + lo);
+        }
+        SWAP(from, to, Key *);
+    }
+    if (from != keys) memcpy(keys, from, n * sizeof *keys);
+}
+
+/* Merge sort, the halves of large sorts as tasks
+ */
+static void sortKeys(Key *keys, Key *tmp, size_t n)
+{
+    if (n <= SORT_MIN_KEYS)
+    {
+        sortBlock(keys, tmp, n);
+        return;
+    }
+
+    size_t half = n / 2;
+    #pragma omp task
+    sortKeys(keys, tmp, half);
+    sortKeys(keys + half, tmp + half, n - half);
+    #pragma omp taskwait
+
+    mergeKeys(keys, half, keys + half, n - half, tmp);
+    memcpy(keys, tmp, n * sizeof *keys);
+}
+
+/* Key of every live edge (once per pair of
+ * half-edges), gathered block by block
+ */
+static Key *gatherEdges(EdgeList *edge_list, size_t *num_keys)
+{
+    char *unused = calloc(edge_list->size, sizeof *unused);
+    for (size_t k = 0; k < edge_list->idx; k++) unused[(edge_list->unused_edges)[k] - edge_list->edges] = 1;
+
+    size_t num_blocks = (edge_list->size + GATHER_SLOTS - 1) / GATHER_SLOTS;
+    size_t *offsets = calloc(num_blocks + 1, sizeof *offsets);
+    Key *keys = malloc((edge_list->size - edge_list->idx) / 2 * sizeof *keys);
+
+    // Count, then fill, each block
+    for (int fill = 0; fill < 2; fill++)
+    {
+        #pragma omp taskloop grainsize(1)
+        for (size_t b = 0; b < num_blocks; b++)
+        {
+            size_t end = (b + 1) * GATHER_SLOTS < edge_list->size ? (b + 1) * GATHER_SLOTS : edge_list->size;
+            size_t m = fill ? offsets[b] : 0;
+            for (size_t s = b * GATHER_SLOTS; s < end; s++)
+            {
+                Edge *e = edge_list->edges + s;
+                if (unused[s] || e->twin < e) continue;
+                if (fill) keys[m] = (Key){distance2(e->orig, e->twin->orig), e};
+                m++;
+            }
+            if (!fill) offsets[b + 1] = m;
+        }
+
+        if (!fill)
+        {
+            for (size_t b = 0; b < num_blocks; b++) offsets[b + 1] += offsets[b];
+        }
+    }
+
+    *num_keys = offsets[num_blocks];
+    free(offsets);
+    free(unused);
+    return keys;
+}
+
+/***********************************
+ * SPANNING TREE *******************
+ ***********************************/
+
+/* Root of x, pointing every other node on the way
+ * at its grandparent. A failed swap only means that
+ * another thread moved the link first
+ */
+static size_t findRoot(_Atomic size_t *parent, size_t x)
+{
+    while (1)
+    {
+        size_t p = atomic_load_explicit(parent + x, memory_order_relaxed);
+        size_t g = atomic_load_explicit(parent + p, memory_order_relaxed);
+        if (p == g) return p;
+
+        atomic_compare_exchange_weak_explicit(parent + x, &p, g, memory_order_relaxed, memory_order_relaxed);
+        x = g;
+    }
+}
+
+/* Edges of the Euclidean minimum spanning tree (a
+ * forest, if the points are not all joined), from
+ * the shortest. Returns a malloc'ed array of one
+ * half-edge per tree edge
+ */
+Edge **spanningTree(PointList *point_list, EdgeList *edge_list, size_t *num_tree_edges)
+{
+    size_t num_keys;
+    Key *keys = gatherEdges(edge_list, &num_keys);
+    Key *tmp = malloc(num_keys * sizeof *tmp);
+    sortKeys(keys, tmp, num_keys);
+    free(tmp);
+
+    size_t num_points = point_list->size;
+    _Atomic size_t *parent = malloc(num_points * sizeof *parent);
+    size_t *rank = calloc(num_points, sizeof *rank);
+    for (size_t t = 0; t < num_points; t++) atomic_init(parent + t, t);
+
+    Point *points = point_list->points;
+    Edge **tree = malloc((num_points ? num_points - 1 : 0) * sizeof *tree);
+    char *joins = malloc(TREE_BATCH_EDGES);
+    size_t n = 0;
+
+    for (size_t lo = 0; lo < num_keys && n + 1 < num_points; lo += TREE_BATCH_EDGES)
+    {
+        size_t hi = lo + TREE_BATCH_EDGES < num_keys ? lo + TREE_BATCH_EDGES : num_keys;
+
+        #pragma omp taskloop
+        for (size_t k = lo; k < hi; k++)
+        {
+            Edge *e = keys[k].e;
+            joins[k - lo] = findRoot(parent, e->orig - points) != findRoot(parent, e->twin->orig - points);
+        }
+
+        for (size_t k = lo; k < hi; k++)
+        {
+            if (!joins[k - lo]) continue;
+
+            Edge *e = keys[k].e;
+            size_t a = findRoot(parent, e->orig - points);
+            size_t b = findRoot(parent, e->twin->orig - points);
+            if (a == b) continue;
+
+            if (rank[a] < rank[b]) SWAP(a, b, size_t);
+            if (rank[a] == rank[b]) rank[a]++;
+            atomic_store_explicit(parent + b, a, memory_order_relaxed);
+
+            tree[n++] = e;
+        }
+    }
+
+    free(joins);
+    free(rank);
+    free((void *)parent);
+    free(keys);
+
+    *num_tree_edges = n;
+    return tree;
+}
+
+/***********************************
+ * NEAREST NEIGHBOURS **************
+ ***********************************/
+
+typedef struct
+{
+    LENGTH distance2;
+    Point *p;
+} Candidate;
+
+/* Frontier of one search, and the points it has
+ * seen, in a small open-addressing set emptied after
+ * each query. One per thread
+ */
+typedef struct
+{
+    Candidate *heap;
+    size_t size;
+    size_t cap;
+    Point **seen;
+    size_t num_seen;
+    size_t seen_cap;
+} Search;
+
+static int candidateLess(const Candidate *a, const Candidate *b)
+{
+    if (a->distance2 != b->distance2) return a->distance2 < b->distance2;
+    return a->p < b->p;
+}
+
+static void pushCandidate(Search *s, Candidate c)
+{
+    if (s->size == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 64;
+        s->heap = realloc(s->heap, s->cap * sizeof *(s->heap));
+    }
+
+    size_t i = (s->size)++;
+    while (i > 0 && candidateLess(&c, s->heap + (i - 1) / 2))
+    {
+        (s->heap)[i] = (s->heap)[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    (s->heap)[i] = c;
+}
+
+static Candidate popCandidate(Search *s)
+{
+    Candidate top = (s->heap)[0];
+    Candidate last = (s->heap)[--(s->size)];
+
+    size_t i = 0;
+    while (2 * i + 1 < s->size)
+    {
+        size_t c = 2 * i + 1;
+        if (c + 1 < s->size && candidateLess(s->heap + c + 1, s->heap + c)) c++;
+        if (!candidateLess(s->heap + c, &last)) break;
+        (s->heap)[i] = (s->heap)[c];
+        i = c;
+    }
+    (s->heap)[i] = last;
+
+    return top;
+}
+
+static size_t hashPoint(const Point *q, size_t cap)
+{
+    uint64_t h = (uint64_t)(uintptr_t)q;
+    h ^= h >> 29;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (cap - 1);
+}
+
+static int markSeen(Search *s, Point *q);
+
+static void growSeen(Search *s)
+{
+    Point **old = s->seen;
+    size_t old_cap = s->seen_cap;
+    s->seen_cap = old_cap ? 2 * old_cap : 64;
+    s->seen = calloc(s->seen_cap, sizeof *(s->seen));
+    s->num_seen = 0;
+    for (size_t i = 0; i < old_cap; i++)
+    {
+        if (old[i]) markSeen(s, old[i]);
+    }
+    free(old);
+}
+
+// Adds q to the seen set, returns 0 if it was there
+static int markSeen(Search *s, Point *q)
+{
+    if (2 * (s->num_seen + 1) > s->seen_cap) growSeen(s);
+
+    size_t mask = s->seen_cap - 1;
+    size_t i = hashPoint(q, s->seen_cap);
+    while ((s->seen)[i])
+    {
+        if ((s->seen)[i] == q) return 0;
+        i = (i + 1) & mask;
+    }
+    (s->seen)[i] = q;
+    (s->num_seen)++;
+    return 1;
+}
+
+// Queue the unseen neighbours of q for the query p
+static void expand(Search *s, Point *p, Point *q)
+{
+    Edge *e = q->e;
+    Edge *f = e;
+    do
+    {
+        Point *r = f->twin->orig;
+        if (markSeen(s, r)) pushCandidate(s, (Candidate){distance2(p, r), r});
+        f = f->twin->dnext;
+    } while (f != e);
+}
+
+static void searchNeighbours(Search *s, Point *p, size_t k, Point **out)
+{
+    s->size = 0;
+    markSeen(s, p);
+    expand(s, p, p);
+
+    size_t n = 0;
+    while (n < k && s->size > 0)
+    {
+        Point *q = popCandidate(s).p;
+        out[n++] = q;
+        if (n < k) expand(s, p, q);
+    }
+    while (n < k) out[n++] = NULL;
+
+    // Only about 6k points were seen, so the
+    // set stays small and is cheap to empty
+    memset(s->seen, 0, s->seen_cap * sizeof *(s->seen));
+    s->num_seen = 0;
+}
+
+/* The k nearest other points of each of the points
+ * triangulated, nearest first. Points are searched
+ * in the order given, so the order a triangulation
+ * leaves them in keeps searches near each other.
+ * Returns a malloc'ed array of k entries per point
+ * of point_list, by index, with NULL past the last
+ * neighbour found
+ */
+Point **nearestNeighbours(PointList *point_list, Point *point_ptr_list[], size_t num_points, size_t k)
+{
+    Point *points = point_list->points;
+    Point **neighbours = malloc(point_list->size * k * sizeof *neighbours);
+    for (size_t t = 0; t < point_list->size * k; t++) neighbours[t] = NULL;
+
+    size_t num_searches = (size_t)teamSize();
+    Search *searches = calloc(num_searches, sizeof *searches);
+
+    #pragma omp taskloop
+    for (size_t idx = 0; idx < num_points; idx++)
+    {
+        Point *p = point_ptr_list[idx];
+        if (p->e == NULL) continue;
+        searchNeighbours(searches + threadIndex(), p, k, neighbours + (p - points) * k);
+    }
+
+    for (size_t t = 0; t < num_searches; t++)
+    {
+        free(searches[t].heap);
+        free(searches[t].seen);
+    }
+    free(searches);
+
+    return neighbours;
+}
+
+/***********************************
+ * OUTPUT **************************
+ ***********************************/
+
+/* One edge per line, as showEdges, from the shortest
+ */
+void writeSpanningTree(PointList *point_list, Edge **tree, size_t num_tree_edges, FILE *out)
+{
+    char text[EDGE_TEXT_MAX];
+    for (size_t t = 0; t < num_tree_edges; t++)
+    {
+        Edge *e = tree[t];
+        if (!compareXY(e->orig, e->twin->orig)) e = e->twin;
+        fwrite(text, 1, formatEdge(text, point_list, e), out);
+    }
+}
+
+/* One line per point with edges: the point,
+ * then its neighbours, nearest first
+ */
+void writeNearestNeighbours(PointList *point_list, Point **neighbours, size_t k, FILE *out)
+{
+    char text[POINT_TEXT_MAX];
+    for (size_t idx = 0; idx < point_list->size; idx++)
+    {
+        Point *p = point_list->points + idx;
+        if (p->e == NULL) continue;
+
+        fwrite(text, 1, formatPoint(text, point_list, p), out);
+        for (size_t i = 0; i < k && neighbours[idx * k + i]; i++)
+        {
+            fputc(' ', out);
+            fwrite(text, 1, formatPoint(text, point_list, neighbours[idx * k + i]), out);
+        }
+        fputc('\n', out);
+    }
+}
@@ -1,7 +1,11 @@
 #include "defs.h"
 #include "helper.h"
 #include <stdio.h>
+#include <time.h>
 #include "io.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /***********************************
  * SELECTION *************************
@@ -31,6 +35,28 @@ void quickselect(Point *point_list[], size_t l, size_t r, size_t k, int (*lessTh
     }
 }
 
+/* Sort array of points between indices l and r
+ * (inclusive), recursing on the smaller side
+ */
+void quicksort(Point *point_list[], size_t l, size_t r, int (*lessThan)(Point *, Point *))
+{
+    while (l < r)
+    {
+        size_t j = partition(point_list, l, r, (r + l) / 2, lessThan);
+        if (j - l < r - j)
+        {
+            if (j > l) quicksort(point_list, l, j - 1, lessThan);
+            l = j + 1;
+        }
+        else
+        {
+            quicksort(point_list, j + 1, r, lessThan);
+            if (j == l) break;
+            r = j - 1;
+        }
+    }
+}
+
 /* Partition list using list[k] as partition value
  */
 size_t partition(Point *point_list[], size_t l, size_t r, size_t k, int (*lessThan)(Point *, Point *))
@@ -50,3 +76,39 @@ size_t partition(Point *point_list[], size_t l, size_t r, size_t k, int (*lessTh
 
     return j;
 }
+
+/***********************************
+ * THREADS *************************
+ ***********************************/
+
+/* Number of threads that can pick up tasks
+ * spawned here, 1 outside a parallel region
+ */
+int teamSize(void)
+{
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+/* Index of the calling thread in its team
+ */
+int threadIndex(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+/* Wall-clock time in seconds, for timings
+ */
+double seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hull.h"
+#include "helper.h"
+#include "io.h"
+#include "topology.h"
+
+/* Convex hull by the divide and conquer of the
+ * triangulation, keeping only the hull chains.
+ *
+ * Points are cut at the median in x and y in turn,
+ * as in delaunay.c, and the hulls of the two halves
+ * are joined by their common tangents, found with
+ * the same walk as the lower common tangent of a
+ * merge: from the extremes of each half nearest the
+ * cut, each end steps round its own hull while the
+ * next vertex lies below the tangent. Nothing inside
+ * the hulls is ever looked at.
+ *
+ * The hull of a call is written counter-clockwise
+ * over the start of its own part of point_list,
+ * which is not needed once the call has cut it, so
+ * only a scratch array of the same size is used.
+ * Vertices in line with their neighbours are left
+ * out, so all points in line give their two ends.
+ *
+ * Most points are dropped before any cut: those
+ * strictly inside the octagon of the extremes in
+ * x, y and the diagonals cannot be on the hull
+ * (Akl-Toussaint).
+ * Both passes over the points are spread over the
+ * threads in blocks
+ */
+
+// Halves smaller than this are done by the
+// thread that reached them
+#define HULL_PARALLEL_MIN_POINTS (1 << 14)
+
+// Points per block of the first passes
+#define HULL_BLOCK_POINTS (1 << 14)
+
+// Directions of the extremes, counter-clockwise
+// from -x
+#define HULL_DIRECTIONS 8
+static const int DIRECTION_X[HULL_DIRECTIONS] = {-1, -1, 0, 1, 1, 1, 0, -1};
+static const int DIRECTION_Y[HULL_DIRECTIONS] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+/* A hull at the start of its part of point_list,
+ * with the indices of its extreme vertices
+ */
+typedef struct
+{
+    size_t size;
+    size_t left;    // least by compareXY
+    size_t right;
+    size_t bottom;  // least by compareYX
+    size_t top;
+} Hull;
+
+static size_t next(const Hull *h, size_t i)
+{
+    return (i + 1 == h->size) ? 0 : i + 1;
+}
+
+static size_t prev(const Hull *h, size_t i)
+{
+    return (i == 0) ? h->size - 1 : i - 1;
+}
+
+/* Whether c, in line with a and b, lies strictly
+ * between them
+ */
+static int between(Point *a, Point *c, Point *b)
+{
+    return (compareXY(a, c) && compareXY(c, b)) || (compareXY(b, c) && compareXY(c, a));
+}
+
+/* Whether the tangent a -> b should step to c:
+ * c is right of it, or in line with it but
+ * beyond its ends
+ */
+static int below(Point *a, Point *b, Point *c)
+{
+    int sign = orientation(a, b, c);
+    return sign < 0 || (sign == 0 && !between(a, c, b));
+}
+
+static void findExtremes(Point *hull[], Hull *h)
+{
+    h->left = h->right = h->bottom = h->top = 0;
+    for (size_t i = 1; i < h->size; i++)
+    {
+        if (compareXY(hull[i], hull[h->left])) h->left = i;
+        if (compareXY(hull[h->right], hull[i])) h->right = i;
+        if (compareYX(hull[i], hull[h->bottom])) h->bottom = i;
+        if (compareYX(hull[h->top], hull[i])) h->top = i;
+    }
+}
+
+/* Hulls of 2 or 3 points
+ */
+static void baseHull(Point *point_list[], size_t num_points, Hull *h)
+{
+    h->size = num_points;
+    if (num_points == 3)
+    {
+        Point *a = point_list[0];
+        Point *b = point_list[1];
+        Point *c = point_list[2];
+        int sign = orientation(a, b, c);
+        if (sign < 0)
+        {
+            point_list[1] = c;
+            point_list[2] = b;
+        }
+        else if (sign == 0)
+        {
+            // Keep the two ends
+            quickselect(point_list, 0, 2, 1, compareXY);
+            point_list[1] = point_list[2];
+            h->size = 2;
+        }
+    }
+    findExtremes(point_list, h);
+}
+
+/* Join the hull of point_list[0, median) and that
+ * of point_list[median, ...), cut across y if
+ * vertical, into a hull at point_list[0]
+ */
+static void mergeHulls(Point *point_list[], Point *scratch[], size_t median, int vertical,
+                       const Hull *first, const Hull *second, Hull *h)
+{
+    Point **f = point_list;
+    Point **s = point_list + median;
+
+    // Lower tangent f[i] -> s[j], walking down
+    // from the extremes nearest the cut
+    size_t i = vertical ? first->top : first->right;
+    size_t j = vertical ? second->bottom : second->left;
+    while (1)
+    {
+        size_t p = prev(first, i);
+        size_t q = next(second, j);
+        if (p != i && below(f[i], s[j], f[p])) i = p;
+        else if (q != j && below(f[i], s[j], s[q])) j = q;
+        else break;
+    }
+
+    // Upper tangent s[l] -> f[k]
+    size_t k = vertical ? first->top : first->right;
+    size_t l = vertical ? second->bottom : second->left;
+    while (1)
+    {
+        size_t n = next(first, k);
+        size_t p = prev(second, l);
+        if (n != k && below(s[l], f[k], f[n])) k = n;
+        else if (p != l && below(s[l], f[k], s[p])) l = p;
+        else break;
+    }
+
+    // f from k round to i, then s from j round to l
+    size_t size = 0;
+    for (size_t t = k; ; t = next(first, t))
+    {
+        scratch[size++] = f[t];
+        if (t == i) break;
+    }
+    for (size_t t = j; ; t = next(second, t))
+    {
+        scratch[size++] = s[t];
+        if (t == l) break;
+    }
+
+    memcpy(point_list, scratch, size * sizeof *point_list);
+    h->size = size;
+    findExtremes(point_list, h);
+}
+
+/* Whether p is strictly left of a -> b, taking
+ * sides with a == b as no constraint
+ */
+static int leftOf(Point *a, Point *b, Point *p)
+{
+    return a == b || orientation(a, b, p) > 0;
+}
+
+static AREA extent(Point *p, int d)
+{
+    return DIRECTION_X[d] * (AREA)p->x + DIRECTION_Y[d] * (AREA)p->y;
+}
+
+/* Move the points that may be hull vertices to the
+ * start of point_list, returning their number.
+ * The extremes lie on the hull in the order of
+ * their directions, so the octagon is convex
+ */
+static size_t dropInterior(Point *point_list[], size_t num_points)
+{
+    size_t num_blocks = (num_points + HULL_BLOCK_POINTS - 1) / HULL_BLOCK_POINTS;
+    Point **extremes = malloc(HULL_DIRECTIONS * num_blocks * sizeof *extremes);
+    size_t *kept = malloc(num_blocks * sizeof *kept);
+
+    #pragma omp taskloop grainsize(1)
+    for (size_t b = 0; b < num_blocks; b++)
+    {
+        size_t lo = b * HULL_BLOCK_POINTS;
+        size_t hi = (lo + HULL_BLOCK_POINTS < num_points) ? lo + HULL_BLOCK_POINTS : num_points;
+        Point **ex = extremes + HULL_DIRECTIONS * b;
+        for (int d = 0; d < HULL_DIRECTIONS; d++) ex[d] = point_list[lo];
+        for (size_t t = lo + 1; t < hi; t++)
+        {
+            Point *p = point_list[t];
+            for (int d = 0; d < HULL_DIRECTIONS; d++)
+            {
+                if (extent(p, d) > extent(ex[d], d)) ex[d] = p;
+            }
+        }
+    }
+
+    Point *octagon[HULL_DIRECTIONS];
+    for (int d = 0; d < HULL_DIRECTIONS; d++)
+    {
+        octagon[d] = extremes[d];
+        for (size_t b = 1; b < num_blocks; b++)
+        {
+            Point *p = extremes[HULL_DIRECTIONS * b + d];
+            if (extent(p, d) > extent(octagon[d], d)) octagon[d] = p;
+        }
+    }
+
+    #pragma omp taskloop grainsize(1)
+    for (size_t b = 0; b < num_blocks; b++)
+    {
+        size_t lo = b * HULL_BLOCK_POINTS;
+        size_t hi = (lo + HULL_BLOCK_POINTS < num_points) ? lo + HULL_BLOCK_POINTS : num_points;
+        size_t size = lo;
+        for (size_t t = lo; t < hi; t++)
+        {
+            Point *p = point_list[t];
+            int inside = 1;
+            for (int d = 0; d < HULL_DIRECTIONS && inside; d++)
+            {
+                inside = leftOf(octagon[d], octagon[(d + 1) % HULL_DIRECTIONS], p);
+            }
+            if (!inside) point_list[size++] = p;
+        }
+        kept[b] = size - lo;
+    }
+
+    size_t size = 0;
+    for (size_t b = 0; b < num_blocks; b++)
+    {
+        memmove(point_list + size, point_list + b * HULL_BLOCK_POINTS, kept[b] * sizeof *point_list);
+        size += kept[b];
+    }
+
+    free(extremes);
+    free(kept);
+    return size;
+}
+
+static void hull(Point *point_list[], Point *scratch[], size_t num_points, int vertical, Hull *h)
+{
+    if (num_points <= 3)
+    {
+        baseHull(point_list, num_points, h);
+        return;
+    }
+
+    size_t median = num_points / 2;
+    quickselect(point_list, 0, num_points - 1, median, vertical ? compareYX : compareXY);
+
+    Hull first;
+    Hull second;
+    if (num_points < HULL_PARALLEL_MIN_POINTS || teamSize() == 1)
+    {
+        hull(point_list, scratch, median, !vertical, &first);
+        hull(point_list + median, scratch + median, num_points - median, !vertical, &second);
+    }
+    else
+    {
+        #pragma omp task shared(first)
+        hull(point_list, scratch, median, !vertical, &first);
+        hull(point_list + median, scratch + median, num_points - median, !vertical, &second);
+        #pragma omp taskwait
+    }
+
+    mergeHulls(point_list, scratch, median, vertical, &first, &second, h);
+}
+
+/* Write the convex hull of the distinct points of
+ * point_list counter-clockwise over its start, from
+ * the least point by compareXY. Returns its size
+ */
+size_t convexHull(Point *point_list[], size_t num_points)
+{
+    if (num_points < 2) return num_points;
+    num_points = dropInterior(point_list, num_points);
+
+    Point **scratch = malloc(num_points * sizeof *scratch);
+
+    Hull h;
+    hull(point_list, scratch, num_points, 0, &h);
+
+    memcpy(scratch, point_list + h.left, (h.size - h.left) * sizeof *scratch);
+    memcpy(scratch + h.size - h.left, point_list, h.left * sizeof *scratch);
+    memcpy(point_list, scratch, h.size * sizeof *point_list);
+
+    free(scratch);
+    return h.size;
+}
+
+/* One hull vertex per line, in order
+ */
+void writeHull(PointList *point_list, Point *hull[], size_t hull_size, FILE *out)
+{
+    char text[POINT_TEXT_MAX];
+    for (size_t t = 0; t < hull_size; t++)
+    {
+        fwrite(text, 1, formatPoint(text, point_list, hull[t]), out);
+        fputc('\n', out);
+    }
+}
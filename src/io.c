@@ -1,7 +1,17 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
 #include "io.h"
 #include "helper.h"
 #include "topology.h"
+#include "queue.h"
+
+// Raw file blocks read ahead of the parser
+#define READ_BLOCK_SIZE (1 << 20)
+#define READ_QUEUE_BLOCKS 8
 
 /* Read points from a file
  * Format of file should be
@@ -11,6 +21,15 @@
  * File should not have an empty newline at end
  */
 PointList *getPoints(const char *filename)
+{
+    return getPointsWithCapacity(filename, 0);
+}
+
+/* Same as getPoints, but leaves room for
+ * extra points to be added later
+ * (for example by replaceRegion)
+ */
+PointList *getPointsWithCapacity(const char *filename, size_t extra)
 {
     FILE *fptr = fopen(filename, "r");
     if (fptr == NULL)
@@ -19,27 +38,20 @@ PointList *getPoints(const char *filename)
         exit(1);
     }
 
-    PointList *point_list = malloc(sizeof *point_list);
-
     size_t BUFF_SIZE = 512;
     char buffer[BUFF_SIZE];
+    size_t num_points = 0;
     if (fgets(buffer, BUFF_SIZE, fptr))
     {
-        sscanf(buffer, "%zu", &(point_list->size));
+        sscanf(buffer, "%zu", &num_points);
     }
 
-    point_list->idx = point_list->size;
-    point_list->points = malloc((point_list->size) * sizeof *(point_list->points));
-    point_list->unused_points = malloc((point_list->size) * sizeof *(point_list->unused_points));
-    for (size_t i = 0; i < point_list->size; i++)
-    {
-        (point_list->unused_points)[i] = point_list->points + point_list->size - 1 - i;
-    }
+    PointList *point_list = initializePointList(num_points + extra);
 
     while (fgets(buffer, BUFF_SIZE, fptr))
     {
         VALUE x, y;
-        sscanf(buffer, "%ld %ld", &x, &y);
+        sscanf(buffer, VALUE_SPEC " " VALUE_SPEC, &x, &y);
 
         makePoint(x, y, point_list);
     }
@@ -47,6 +59,402 @@ PointList *getPoints(const char *filename)
     return point_list;
 }
 
+/* Point lines start with two integers (an optional
+ * sign, then digits), each followed by whitespace.
+ * Anything after them, such as a height, is left to
+ * other readers, and blank lines are skipped. Both
+ * readers below stop on any other line
+ */
+static int isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0';
+}
+
+static void malformedPoint(size_t n)
+{
+    printf("Point %zu is malformed\nExiting...\n", n);
+    exit(1);
+}
+
+static void outOfRangePoint(size_t n)
+{
+    printf("Point %zu is out of range\nExiting...\n", n);
+    exit(1);
+}
+
+// Parses one coordinate at *s and moves past it
+static long parseCoordinate(const char **s, size_t n)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(*s, &end, 10);
+    if (end == *s || !isBlank(*end)) malformedPoint(n);
+
+    // labs is undefined on LONG_MIN
+    if (errno == ERANGE || v == LONG_MIN) outOfRangePoint(n);
+
+    *s = end;
+    return v;
+}
+
+/* Read raw coordinates (x_0 y_0 x_1 y_1 ...) from a
+ * file in the getPoints format, without building points,
+ * so that the coordinate width can be picked afterwards.
+ * Reports the number of points read and the largest
+ * coordinate magnitude seen
+ */
+long *readCoordinates(const char *filename, size_t *num_points, long *max_abs)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    size_t BUFF_SIZE = 512;
+    char buffer[BUFF_SIZE];
+    size_t size = 0;
+    if (fgets(buffer, BUFF_SIZE, fptr))
+    {
+        sscanf(buffer, "%zu", &size);
+    }
+
+    long *xy = malloc(2 * size * sizeof *xy);
+    size_t n = 0;
+    *max_abs = 0;
+    while (n < size && fgets(buffer, BUFF_SIZE, fptr))
+    {
+        const char *s = buffer;
+        while (*s && isBlank(*s)) s++;
+        if (*s == '\0') continue;
+
+        long x = parseCoordinate(&s, n);
+        long y = parseCoordinate(&s, n);
+
+        if (labs(x) > *max_abs) *max_abs = labs(x);
+        if (labs(y) > *max_abs) *max_abs = labs(y);
+        xy[2 * n] = x;
+        xy[2 * n + 1] = y;
+        n++;
+    }
+    fclose(fptr);
+
+    *num_points = n;
+    return xy;
+}
+
+/* Same as readCoordinates, for floating-point
+ * coordinates. Points that are not finite are
+ * rejected, as no grid can hold them
+ */
+double *readFloatCoordinates(const char *filename, size_t *num_points)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    size_t BUFF_SIZE = 512;
+    char buffer[BUFF_SIZE];
+    size_t size = 0;
+    if (fgets(buffer, BUFF_SIZE, fptr))
+    {
+        sscanf(buffer, "%zu", &size);
+    }
+
+    double *xy = malloc(2 * size * sizeof *xy);
+    size_t n = 0;
+    while (n < size && fgets(buffer, BUFF_SIZE, fptr))
+    {
+        double x = 0, y = 0;
+        sscanf(buffer, "%lf %lf", &x, &y);
+
+        if (!isfinite(x) || !isfinite(y))
+        {
+            printf("Point %zu is not finite\nExiting...\n", n);
+            exit(1);
+        }
+        xy[2 * n] = x;
+        xy[2 * n + 1] = y;
+        n++;
+    }
+    fclose(fptr);
+
+    *num_points = n;
+    return xy;
+}
+
+/* Read segments from a file
+ * Format of file should be
+ *  1st line - Number of segments
+ *  Each following line - Space-seperated
+ *      indices of the endpoints of a segment
+ *      in the point list
+ */
+size_t *readSegments(const char *filename, size_t num_points, size_t *num_segments)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    size_t BUFF_SIZE = 512;
+    char buffer[BUFF_SIZE];
+    size_t size = 0;
+    if (fgets(buffer, BUFF_SIZE, fptr))
+    {
+        sscanf(buffer, "%zu", &size);
+    }
+
+    size_t *segments = malloc(2 * size * sizeof *segments);
+    size_t n = 0;
+    while (n < size && fgets(buffer, BUFF_SIZE, fptr))
+    {
+        size_t a = num_points, b = num_points;
+        sscanf(buffer, "%zu %zu", &a, &b);
+
+        if (a >= num_points || b >= num_points)
+        {
+            printf("Segment %zu does not join two points\nExiting...\n", n);
+            exit(1);
+        }
+        segments[2 * n] = a;
+        segments[2 * n + 1] = b;
+        n++;
+    }
+    fclose(fptr);
+
+    *num_segments = n;
+    return segments;
+}
+
+/* Read the height of each point, the third
+ * number on its line of a getPoints file
+ */
+double *readHeights(const char *filename, size_t num_points)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    size_t BUFF_SIZE = 512;
+    char buffer[BUFF_SIZE];
+    if (!fgets(buffer, BUFF_SIZE, fptr)) num_points = 0;
+
+    double *heights = malloc(num_points * sizeof *heights);
+    size_t n = 0;
+    while (n < num_points && fgets(buffer, BUFF_SIZE, fptr))
+    {
+        double z = NAN;
+        sscanf(buffer, "%*s %*s %lf", &z);
+
+        if (!isfinite(z))
+        {
+            printf("Point %zu has no height\nExiting...\n", n);
+            exit(1);
+        }
+        heights[n++] = z;
+    }
+    fclose(fptr);
+
+    return heights;
+}
+
+/* Snap floating-point coordinates onto the integer
+ * grid. Points are centred on their bounding box and
+ * scaled by 2^exponent, the largest power of two that
+ * keeps every coordinate below NARROW_COORD_LIMIT, so
+ * the predicates are exact and the narrow variant can
+ * be used. Scaling by a power of two adds no rounding
+ * of its own: each point moves by at most half a unit
+ * of the grid, that is 2^-(exponent + 1). Points closer
+ * than that may land on the same grid point
+ */
+long *quantizeCoordinates(const double *original, size_t num_points, int *exponent)
+{
+    double x_lo = INFINITY, x_hi = -INFINITY;
+    double y_lo = INFINITY, y_hi = -INFINITY;
+    for (size_t t = 0; t < num_points; t++)
+    {
+        x_lo = fmin(x_lo, original[2 * t]);
+        x_hi = fmax(x_hi, original[2 * t]);
+        y_lo = fmin(y_lo, original[2 * t + 1]);
+        y_hi = fmax(y_hi, original[2 * t + 1]);
+    }
+
+    double cx = num_points ? x_lo + (x_hi - x_lo) / 2 : 0;
+    double cy = num_points ? y_lo + (y_hi - y_lo) / 2 : 0;
+    double half = num_points ? fmax(x_hi - x_lo, y_hi - y_lo) / 2 : 0;
+
+    // half < 2^e, so half * 2^(29 - e) < 2^29, with a
+    // unit to spare for the rounding of the centring
+    int e = 0;
+    int k = 0;
+    if (half > 0)
+    {
+        frexp(half, &e);
+        k = 29 - e;
+        if (ldexp(half, k) > (double)(NARROW_COORD_LIMIT - 2)) k--;
+    }
+
+    long *xy = malloc(2 * num_points * sizeof *xy);
+    for (size_t t = 0; t < num_points; t++)
+    {
+        xy[2 * t] = lround(ldexp(original[2 * t] - cx, k));
+        xy[2 * t + 1] = lround(ldexp(original[2 * t + 1] - cy, k));
+    }
+
+    *exponent = k;
+    return xy;
+}
+
+typedef struct
+{
+    FILE *fptr;
+    Queue *queue;
+} Reader;
+
+static int readBlocks(void *arg)
+{
+    Reader *reader = arg;
+    while (1)
+    {
+        char *data = malloc(READ_BLOCK_SIZE);
+        size_t size = fread(data, 1, READ_BLOCK_SIZE, reader->fptr);
+        if (size == 0)
+        {
+            free(data);
+            break;
+        }
+        pushBlock(reader->queue, (Block){data, size});
+    }
+    closeQueue(reader->queue);
+    return 0;
+}
+
+/* Same as readCoordinates, but the file is read by
+ * a second thread a few blocks ahead of the parser,
+ * so that waiting on storage overlaps parsing.
+ * Numbers may be split across blocks, so they are
+ * parsed one character at a time
+ */
+long *streamCoordinates(const char *filename, size_t *num_points, long *max_abs)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    Reader reader = {fptr, initializeQueue(READ_QUEUE_BLOCKS)};
+    thrd_t thread;
+    if (thrd_create(&thread, readBlocks, &reader) != thrd_success)
+    {
+        printf("Failed to start reader thread\nExiting...\n");
+        exit(1);
+    }
+
+    size_t size = 0;
+    long *xy = NULL;
+    size_t n = 0;
+    *max_abs = 0;
+
+    // Position of the number being parsed
+    size_t line = 0;
+    size_t column = 0;
+    long value = 0;
+    int negative = 0;
+    int sign = 0;
+    int in_number = 0;
+    int overflow = 0;
+    long x = 0;
+
+    Block block;
+    int more = 1;
+    while (more)
+    {
+        more = popBlock(reader.queue, &block);
+
+        // A last pass over a newline ends the final number
+        const char *data = more ? block.data : "\n";
+        size_t count = more ? block.size : 1;
+
+        for (size_t t = 0; t < count; t++)
+        {
+            char c = data[t];
+            if (c >= '0' && c <= '9')
+            {
+                // Magnitudes are accumulated positive, so
+                // LONG_MIN is out of range too, as labs needs
+                if (value > (LONG_MAX - (c - '0')) / 10) overflow = 1;
+                else value = 10 * value + (c - '0');
+                in_number = 1;
+                sign = 0;
+                continue;
+            }
+
+            // Checked as readCoordinates does
+            int checked = line > 0 && column < 2 && n < size;
+            if (in_number)
+            {
+                if (negative) value = -value;
+
+                if (checked && !isBlank(c)) malformedPoint(n);
+                if (checked && overflow) outOfRangePoint(n);
+
+                if (line == 0 && column == 0)
+                {
+                    size = (size_t)value;
+                    xy = malloc(2 * size * sizeof *xy);
+                }
+                else if (line > 0 && column == 0) x = value;
+                else if (line > 0 && column == 1 && n < size)
+                {
+                    if (labs(x) > *max_abs) *max_abs = labs(x);
+                    if (labs(value) > *max_abs) *max_abs = labs(value);
+                    xy[2 * n] = x;
+                    xy[2 * n + 1] = value;
+                    n++;
+                }
+
+                column++;
+                value = 0;
+                in_number = 0;
+                overflow = 0;
+            }
+            else if (checked && (sign || !(isBlank(c) || c == '-' || c == '+'))) malformedPoint(n);
+
+            negative = (c == '-');
+            sign = (c == '-' || c == '+');
+            if (c == '\n')
+            {
+                // A lone coordinate
+                if (line > 0 && column == 1 && n < size) malformedPoint(n);
+                line++;
+                column = 0;
+            }
+        }
+
+        if (more) free(block.data);
+    }
+
+    thrd_join(thread, NULL);
+    freeQueue(reader.queue);
+    fclose(fptr);
+
+    *num_points = n;
+    return xy;
+}
+
 /* Display all points on stdout, using showPoint function
  */
 void showPoints(Point *point_list[], size_t num_points)
@@ -63,7 +471,7 @@ void showPoints(Point *point_list[], size_t num_points)
  */
 void showPoint(Point *p)
 {
-    printf("%ld %ld", p->x, p->y);
+    printf(VALUE_SPEC " " VALUE_SPEC, p->x, p->y);
 }
 
 /* Convert edge to string, using show point
@@ -80,19 +488,18 @@ void showEdge(Edge *e)
  */
 void showEdges(PointList *point_list)
 {
+    writeEdges(point_list, stdout);
+}
+
+/* Same as showEdges, to any stream
+ */
+void writeEdges(PointList *point_list, FILE *out)
+{
+    char text[EDGE_TEXT_MAX];
+
+    // Unused points never have edges
     for (size_t idx = 0; idx < point_list->size; idx++)
     {
-        int unused = 0;
-        for (size_t t = 0; t < point_list->idx; t++)
-        {
-            if ((point_list->unused_points)[t] == point_list->points + idx)
-            {
-                unused = 1;
-                break;
-            }
-        }
-        if (unused) continue;
-
         Point p = (point_list->points)[idx];
         Edge *e = p.e;
         Edge *f = p.e;
@@ -104,15 +511,54 @@ void showEdges(PointList *point_list)
 
             if (compareXY(f->orig, f->twin->orig))
             {
-                #ifdef COORD_OUTPUT
-                // Show coordinates of endpoints
-                showEdge(f);
-                printf("\n");
-                #else
-                // Show index in point list of endpoints
-                printf(VALUE_SPEC" "VALUE_SPEC"\n", f->orig - point_list->points, f->twin->orig - point_list->points);
-                #endif
+                fwrite(text, 1, formatEdge(text, point_list, f), out);
             }
         } while (f != e);
     }
 }
+
+#ifdef COORD_OUTPUT
+/* Shortest of %.15g and %.17g that reads back
+ * as the same double
+ */
+static int formatDouble(char *text, double value)
+{
+    int size = sprintf(text, "%.15g", value);
+    if (strtod(text, NULL) == value) return size;
+    return sprintf(text, "%.17g", value);
+}
+#endif
+
+/* Write a point as output shows it: its index in the
+ * point list, or with COORD_OUTPUT its coordinates,
+ * as read if they were quantized from floating point.
+ * Returns the length written, at most POINT_TEXT_MAX - 1
+ */
+int formatPoint(char *text, const PointList *point_list, const Point *p)
+{
+    #ifdef COORD_OUTPUT
+    if (point_list->original != NULL)
+    {
+        const double *xy = point_list->original + 2 * (p - point_list->points);
+        int size = formatDouble(text, xy[0]);
+        text[size++] = ' ';
+        return size + formatDouble(text + size, xy[1]);
+    }
+    return sprintf(text, VALUE_SPEC " " VALUE_SPEC, p->x, p->y);
+    #else
+    return sprintf(text, "%td", p - point_list->points);
+    #endif
+}
+
+/* Write the output line of an edge, from its origin.
+ * Returns the length written, at most EDGE_TEXT_MAX - 1
+ */
+int formatEdge(char *text, const PointList *point_list, const Edge *e)
+{
+    int size = formatPoint(text, point_list, e->orig);
+    text[size++] = ' ';
+    size += formatPoint(text + size, point_list, e->twin->orig);
+    text[size++] = '\n';
+    text[size] = '\0';
+    return size;
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "levels.h"
+#include "delaunay.h"
+#include "helper.h"
+
+/* Bottom-up merge scheduler.
+ *
+ * Builds the triangulation of delaunay_horizontal
+ * without recursion. The cuts are laid out first,
+ * from the root down one level at a time: every node
+ * of a level is split at its median, by x on even
+ * levels and by y on odd ones, as the recursion
+ * would, which leaves the points in leaf order.
+ * The levels are then worked from the bottom up:
+ * each node is either a leaf (2 or 3 points) or
+ * merges its two children from the level below.
+ * Hull extremes live in one array per level instead
+ * of being malloc'ed per call.
+ *
+ * Node k of a level has children 2k and 2k + 1 on
+ * the next. Node sizes on a level differ by at most
+ * one, so leaves only sit on the last two levels,
+ * and nodes below a leaf are left empty.
+ *
+ * Going through whole levels of a large input would
+ * sweep the entire mesh once per level, so below the
+ * first level with nodes of at most LEVEL_BLOCK_POINTS
+ * the levels are worked block by block: each such
+ * node has its subtree laid out and merged, level by
+ * level, before the next one is started. Blocks, and
+ * the nodes of each level above them, are spread over
+ * the team as a taskloop.
+ *
+ * With more than one thread, each node owns a slice
+ * of the unused edges, nested in its parent's as with
+ * splitEdgeList, so all nodes of a level can be worked
+ * at once. Otherwise, or if the edge list has less
+ * room than that (as when a region is re-triangulated
+ * in place), every node takes from the one stack, one
+ * node at a time, which saves joining the slices.
+ */
+
+#define LEVEL_BLOCK_POINTS (1 << 12)
+
+typedef struct
+{
+    size_t lo;      // point_list[lo, hi)
+    size_t hi;
+    size_t start;   // first unused edge of the slice
+    size_t idx;     // unused edges left in the slice
+    Point *split;   // least point of the second child
+} Node;
+
+/* The edge list a node works in: its own slice,
+ * or the shared list
+ */
+static EdgeList *nodeEdgeList(EdgeList *edge_list, int sliced, const Node *node, EdgeList *slice)
+{
+    if (!sliced) return edge_list;
+
+    slice->edges = edge_list->edges;
+    slice->unused_edges = edge_list->unused_edges + node->start;
+    slice->idx = slice->size = edgeCapacity(node->hi - node->lo);
+    slice->parent = NULL;
+    slice->fixed = edge_list->fixed;
+    return slice;
+}
+
+/* Slice of a child as left by its own work
+ */
+static void childEdgeList(EdgeList *edge_list, const Node *child, EdgeList *slice)
+{
+    slice->edges = edge_list->edges;
+    slice->unused_edges = edge_list->unused_edges + child->start;
+    slice->size = edgeCapacity(child->hi - child->lo);
+    slice->idx = child->idx;
+    slice->parent = NULL;
+    slice->fixed = edge_list->fixed;
+}
+
+static void workNode(Point *point_list[], Node *level, Node *children, size_t k, int vertical,
+                     ExtremeEdge *below, ExtremeEdge *extremes, EdgeList *edge_list, int sliced)
+{
+    Node *node = level + k;
+    size_t num_points = node->hi - node->lo;
+    if (num_points == 0) return;
+
+    EdgeList slice;
+    EdgeList *list = nodeEdgeList(edge_list, sliced, node, &slice);
+
+    if (num_points == 2) delaunay2(point_list + node->lo, list, extremes + k);
+    else if (num_points == 3) delaunay3(point_list + node->lo, list, extremes + k);
+    else
+    {
+        if (sliced)
+        {
+            EdgeList first;
+            EdgeList second;
+            childEdgeList(edge_list, children + 2 * k, &first);
+            childEdgeList(edge_list, children + 2 * k + 1, &second);
+            joinEdgeLists(list, &first, &second);
+        }
+
+        ExtremeEdge *first_ex = below + 2 * k;
+        ExtremeEdge *second_ex = below + 2 * k + 1;
+        if (vertical) mergeVertical(first_ex, second_ex, node->split, num_points, list, extremes + k);
+        else mergeHorizontal(first_ex, second_ex, node->split, num_points, list, extremes + k);
+    }
+
+    node->idx = list->idx;
+}
+
+typedef struct
+{
+    Point **point_list;
+    EdgeList *edge_list;
+    int sliced;
+    size_t depth;
+    Node **levels;
+    ExtremeEdge **extremes;
+    LevelStats *stats;
+} Tree;
+
+/* Split nodes [first, last) of level d at
+ * their medians and lay out their children
+ */
+static void splitNodes(Tree *tree, size_t d, size_t first, size_t last)
+{
+    Node *level = tree->levels[d];
+    Node *next = (d < tree->depth) ? tree->levels[d + 1] : NULL;
+    int (*lessThan)(Point *, Point *) = (d % 2) ? compareYX : compareXY;
+
+    for (size_t k = first; k < last; k++)
+    {
+        Node *node = level + k;
+        size_t m = node->hi - node->lo;
+        if (m <= 3)
+        {
+            if (next) next[2 * k] = next[2 * k + 1] = (Node){node->lo, node->lo, node->start, 0, NULL};
+            continue;
+        }
+
+        size_t median = node->lo + m / 2;
+        quickselect(tree->point_list + node->lo, 0, m - 1, m / 2, lessThan);
+        node->split = tree->point_list[median];
+
+        next[2 * k] = (Node){node->lo, median, node->start, 0, NULL};
+        next[2 * k + 1] = (Node){median, node->hi, node->start + edgeCapacity(m / 2), 0, NULL};
+    }
+}
+
+/* Triangulate or merge nodes [first, last) of level d
+ */
+static void workNodes(Tree *tree, size_t d, size_t first, size_t last)
+{
+    Node *level = tree->levels[d];
+    Node *children = (d < tree->depth) ? tree->levels[d + 1] : NULL;
+    ExtremeEdge *below = (d < tree->depth) ? tree->extremes[d + 1] : NULL;
+
+    for (size_t k = first; k < last; k++)
+    {
+        workNode(tree->point_list, level, children, k, d % 2, below, tree->extremes[d], tree->edge_list, tree->sliced);
+    }
+}
+
+static void addSeconds(double *total, double seconds)
+{
+    #pragma omp atomic
+    *total += seconds;
+}
+
+/* Lay out and merge the subtree under node
+ * r of level b, one level at a time
+ */
+static void workBlock(Tree *tree, size_t b, size_t r)
+{
+    for (size_t d = b; d < tree->depth; d++)
+    {
+        double start = seconds();
+        splitNodes(tree, d, r << (d - b), (r + 1) << (d - b));
+        addSeconds(&tree->stats[d].split_seconds, seconds() - start);
+    }
+
+    for (size_t d = tree->depth + 1; d-- > b;)
+    {
+        double start = seconds();
+        workNodes(tree, d, r << (d - b), (r + 1) << (d - b));
+        addSeconds(&tree->stats[d].merge_seconds, seconds() - start);
+    }
+}
+
+ExtremeEdge *delaunayLevels(Point *point_list[], size_t num_points, EdgeList *edge_list,
+                            LevelStats **stats, size_t *num_levels)
+{
+    if (num_points < 2)
+    {
+        printf("Something has gone very wrong.\nTrying to triangulate fewer than 2 points.\nExiting...\n");
+        exit(1);
+    }
+
+    Tree tree;
+    tree.point_list = point_list;
+    tree.edge_list = edge_list;
+    tree.sliced = teamSize() > 1 && edge_list->idx >= edgeCapacity(num_points);
+
+    // Largest node on a level has ceil(n / 2^d) points
+    size_t depth = 0;
+    size_t block = 0;
+    for (size_t m = num_points; m > 3; m -= m / 2)
+    {
+        depth++;
+        if (m > LEVEL_BLOCK_POINTS) block = depth;
+    }
+    tree.depth = depth;
+
+    tree.levels = malloc((depth + 1) * sizeof *(tree.levels));
+    tree.extremes = malloc((depth + 1) * sizeof *(tree.extremes));
+    tree.stats = calloc(depth + 1, sizeof *(tree.stats));
+    for (size_t d = 0; d <= depth; d++)
+    {
+        tree.levels[d] = malloc(((size_t)1 << d) * sizeof **(tree.levels));
+        tree.extremes[d] = malloc(((size_t)1 << d) * sizeof **(tree.extremes));
+    }
+    tree.levels[0][0] = (Node){0, num_points, 0, 0, NULL};
+
+    // Lay out the cuts above the blocks
+    for (size_t d = 0; d < block; d++)
+    {
+        double start = seconds();
+
+        #pragma omp taskloop
+        for (size_t k = 0; k < ((size_t)1 << d); k++) splitNodes(&tree, d, k, k + 1);
+
+        tree.stats[d].split_seconds = seconds() - start;
+    }
+
+    #pragma omp taskloop if(tree.sliced)
+    for (size_t r = 0; r < ((size_t)1 << block); r++) workBlock(&tree, block, r);
+
+    // Merge the levels above the blocks
+    for (size_t d = block; d-- > 0;)
+    {
+        double start = seconds();
+
+        #pragma omp taskloop if(tree.sliced)
+        for (size_t k = 0; k < ((size_t)1 << d); k++) workNodes(&tree, d, k, k + 1);
+
+        tree.stats[d].merge_seconds = seconds() - start;
+    }
+
+    for (size_t d = 0; d <= depth; d++)
+    {
+        for (size_t k = 0; k < ((size_t)1 << d); k++)
+        {
+            size_t m = tree.levels[d][k].hi - tree.levels[d][k].lo;
+            if (m > 3) tree.stats[d].merges++;
+            else if (m > 0) tree.stats[d].leaves++;
+        }
+    }
+
+    // Gather the root's unused edges and any
+    // beyond its slice back into one stack
+    if (tree.sliced)
+    {
+        size_t root_size = edgeCapacity(num_points);
+        size_t rest = edge_list->idx - root_size;
+        memmove(edge_list->unused_edges + tree.levels[0][0].idx, edge_list->unused_edges + root_size,
+                rest * sizeof *(edge_list->unused_edges));
+        edge_list->idx = tree.levels[0][0].idx + rest;
+    }
+
+    ExtremeEdge *ex = malloc(sizeof *ex);
+    *ex = tree.extremes[0][0];
+
+    for (size_t d = 0; d <= depth; d++)
+    {
+        free(tree.levels[d]);
+        free(tree.extremes[d]);
+    }
+    free(tree.levels);
+    free(tree.extremes);
+
+    if (stats)
+    {
+        *stats = tree.stats;
+        *num_levels = depth + 1;
+    }
+    else free(tree.stats);
+
+    return ex;
+}
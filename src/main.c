@@ -1,41 +1,149 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "defs.h"
-#include "helper.h"
-#include "delaunay.h"
-#include "topology.h"
+#include "run.h"
 #include "io.h"
+#include "batch.h"
+
+static void usage(void)
+{
+    printf("Usage: delaunay [options] <input-file>\n");
+    printf("       delaunay [options] --batch=<manifest>\n");
+    printf("Options:\n");
+    printf("  --backend=edge      half-edge divide and conquer (default)\n");
+    printf("  --backend=triangle  triangle arrays built by a sweep\n");
+    printf("  --time              report triangulation time on stderr\n");
+    printf("  --threads=N         threads for the edge backend\n");
+    printf("  --pipeline          overlap reading, triangulation and output\n");
+    printf("  --levels            merge level by level instead of recursing\n");
+    printf("  --float             read floating-point coordinates and snap them to a grid\n");
+    printf("  --verify            check the triangulation before writing it\n");
+    printf("  --batch=FILE        triangulate each 'input output' pair listed in FILE\n");
+    printf("  --max-edge=L        keep only triangles with no edge longer than L\n");
+    printf("  --alpha=R           keep only triangles with circumradius at most R\n");
+    printf("  --boundary=FILE     write the boundary polygons of the kept triangles to FILE\n");
+    printf("  --duplicates=FILE   write each dropped duplicate point and the point kept to FILE\n");
+    printf("  --constraints=FILE  make each segment listed in FILE an edge\n");
+    printf("  --emst              write the Euclidean minimum spanning tree instead\n");
+    printf("  --knn=K             write the K nearest neighbours of each point instead\n");
+    printf("  --hull              write only the convex hull, without triangulating\n");
+    printf("  --simplify=Z        triangulate few enough points to keep heights within Z\n");
+    exit(1);
+}
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    Options options = {.backend = BACKEND_EDGE};
+    const char* filename = NULL;
+    const char* manifest = NULL;
+    int floating = 0;
+
+    for (int i = 1; i < argc; i++)
     {
-        printf("Usage: delaunay <input-file>\n");
-        exit(1);
+        if (strcmp(argv[i], "--backend=edge") == 0) options.backend = BACKEND_EDGE;
+        else if (strcmp(argv[i], "--backend=triangle") == 0) options.backend = BACKEND_TRIANGLE;
+        else if (strcmp(argv[i], "--time") == 0) options.timing = 1;
+        else if (strcmp(argv[i], "--pipeline") == 0) options.pipeline = 1;
+        else if (strcmp(argv[i], "--levels") == 0) options.levels = 1;
+        else if (strcmp(argv[i], "--float") == 0) floating = 1;
+        else if (strcmp(argv[i], "--verify") == 0) options.verify = 1;
+        else if (strncmp(argv[i], "--batch=", 8) == 0) manifest = argv[i] + 8;
+        else if (strncmp(argv[i], "--max-edge=", 11) == 0)
+        {
+            options.max_edge = atof(argv[i] + 11);
+            if (options.max_edge <= 0) usage();
+        }
+        else if (strncmp(argv[i], "--alpha=", 8) == 0)
+        {
+            options.alpha = atof(argv[i] + 8);
+            if (options.alpha <= 0) usage();
+        }
+        else if (strncmp(argv[i], "--boundary=", 11) == 0) options.boundary = argv[i] + 11;
+        else if (strncmp(argv[i], "--duplicates=", 13) == 0) options.duplicates = argv[i] + 13;
+        else if (strncmp(argv[i], "--constraints=", 14) == 0) options.constraints = argv[i] + 14;
+        else if (strcmp(argv[i], "--emst") == 0) options.emst = 1;
+        else if (strcmp(argv[i], "--hull") == 0) options.hull = 1;
+        else if (strncmp(argv[i], "--simplify=", 11) == 0)
+        {
+            options.simplify = atof(argv[i] + 11);
+            if (options.simplify <= 0) usage();
+        }
+        else if (strncmp(argv[i], "--knn=", 6) == 0)
+        {
+            options.knn = atoi(argv[i] + 6);
+            if (options.knn < 1) usage();
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            options.threads = atoi(argv[i] + 10);
+            if (options.threads < 1) usage();
+        }
+        else if (argv[i][0] == '-' || filename) usage();
+        else filename = argv[i];
     }
-    const char* filename = argv[1];
-    PointList *point_list = getPoints(filename);
-    size_t num_points = point_list->size;
 
-    EdgeList *edge_list = initializeEdgeList(num_points);
+    // Filters, graphs, constraints, the list of duplicates
+    // and checks apply to single runs of the edge backend.
+    // Graphs are of the unconstrained triangulation
+    int filtered = options.max_edge > 0 || options.alpha > 0;
+    int graph = options.emst || options.knn > 0;
+    int extras = filtered || graph || options.boundary || options.duplicates || options.constraints || options.verify;
+    if (extras && (manifest || options.backend != BACKEND_EDGE)) usage();
+    if (options.boundary && !filtered) usage();
+    if ((options.emst && options.knn > 0) || (graph && (filtered || options.constraints))) usage();
+
+    // The level scheduler has no streaming hooks and
+    // no triangle-array counterpart
+    if (options.levels && (options.pipeline || options.backend != BACKEND_EDGE)) usage();
 
-    Point **point_ptr_list = malloc(num_points * sizeof *point_ptr_list);
-    for (size_t t = 0; t < num_points; t++)
+    // The hull alone needs no triangulation to
+    // filter, check or draw graphs from
+    int triangulated = filtered || graph || options.constraints || options.verify || options.levels;
+    if (options.hull && (triangulated || manifest || options.backend != BACKEND_EDGE)) usage();
+
+    // Simplification builds its own triangulation
+    int simplified = options.simplify > 0;
+    if (simplified && (triangulated || options.hull || options.pipeline || manifest)) usage();
+    if (simplified && options.backend != BACKEND_EDGE) usage();
+
+    // Tiles always use the edge backend
+    if (manifest)
     {
-        point_ptr_list[t] = point_list->points + t;
+        if (filename || floating || options.backend != BACKEND_EDGE) usage();
+        runBatch(manifest, &options);
+        return 0;
     }
+    if (filename == NULL) usage();
 
-    ExtremeEdge *ex = delaunay_horizontal(point_ptr_list, num_points, edge_list);
+    // Floating-point input is quantized to fit the
+    // narrow variant, and filters scaled to match
+    size_t num_points;
+    if (floating)
+    {
+        double *original = readFloatCoordinates(filename, &num_points);
+        int exponent;
+        long *xy = quantizeCoordinates(original, num_points, &exponent);
+        options.max_edge = ldexp(options.max_edge, exponent);
+        options.alpha = ldexp(options.alpha, exponent);
 
-    showEdges(point_list);
+        double *heights = simplified ? readHeights(filename, num_points) : NULL;
+        runNarrow(xy, original, heights, num_points, &options);
+        free(heights);
+        free(original);
+        return 0;
+    }
 
-    free(ex);
+    // Pick the coordinate width from the range seen at load
+    long max_abs;
+    long *xy = options.pipeline ? streamCoordinates(filename, &num_points, &max_abs)
+                                : readCoordinates(filename, &num_points, &max_abs);
 
-    freePoints(point_list);
-    freeEdges(edge_list);
-    free(edge_list);
-    free(point_list);
-    free(point_ptr_list);
+    double *heights = simplified ? readHeights(filename, num_points) : NULL;
+    if (max_abs < NARROW_COORD_LIMIT) runNarrow(xy, NULL, heights, num_points, &options);
+    else runWide(xy, NULL, heights, num_points, &options);
+    free(heights);
 
     return 0;
 }
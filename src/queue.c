@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include "queue.h"
+
+Queue *initializeQueue(size_t capacity)
+{
+    Queue *queue = malloc(sizeof *queue);
+
+    queue->blocks = malloc(capacity * sizeof *(queue->blocks));
+    queue->head = 0;
+    queue->count = 0;
+    queue->capacity = capacity;
+    queue->closed = 0;
+
+    mtx_init(&queue->lock, mtx_plain);
+    cnd_init(&queue->not_empty);
+    cnd_init(&queue->not_full);
+
+    return queue;
+}
+
+void pushBlock(Queue *queue, Block block)
+{
+    mtx_lock(&queue->lock);
+    while (queue->count == queue->capacity) cnd_wait(&queue->not_full, &queue->lock);
+
+    (queue->blocks)[(queue->head + queue->count) % queue->capacity] = block;
+    queue->count++;
+
+    cnd_signal(&queue->not_empty);
+    mtx_unlock(&queue->lock);
+}
+
+/* Take the oldest block. Returns 0 once the
+ * queue is closed and every block has been taken
+ */
+int popBlock(Queue *queue, Block *block)
+{
+    mtx_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed) cnd_wait(&queue->not_empty, &queue->lock);
+
+    if (queue->count == 0)
+    {
+        mtx_unlock(&queue->lock);
+        return 0;
+    }
+
+    *block = (queue->blocks)[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+
+    cnd_signal(&queue->not_full);
+    mtx_unlock(&queue->lock);
+    return 1;
+}
+
+/* No more blocks will be pushed
+ */
+void closeQueue(Queue *queue)
+{
+    mtx_lock(&queue->lock);
+    queue->closed = 1;
+    cnd_broadcast(&queue->not_empty);
+    mtx_unlock(&queue->lock);
+}
+
+void freeQueue(Queue *queue)
+{
+    mtx_destroy(&queue->lock);
+    cnd_destroy(&queue->not_empty);
+    cnd_destroy(&queue->not_full);
+    free(queue->blocks);
+    free(queue);
+}
@@ -0,0 +1,583 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "region.h"
+#include "delaunay.h"
+#include "topology.h"
+#include "helper.h"
+#include "dedup.h"
+
+/* A regional update replaces every point inside a box.
+ *
+ * The cavity is the set of faces (triangles, plus one
+ * 'ghost' per hull edge standing for the outer face)
+ * whose closed circumdisk (half-plane for ghosts)
+ * meets the box, grown across cocircular pairs so no
+ * boundary edge is an ambiguous diagonal. Every face
+ * outside the cavity stays Delaunay after the update,
+ * and every boundary edge is an edge of the Delaunay
+ * triangulation of the cavity vertices, so the cavity
+ * is re-triangulated on its own with the usual divide
+ * and conquer and stitched back in along the boundary.
+ */
+
+typedef struct
+{
+    VALUE x_min;
+    VALUE y_min;
+    VALUE x_max;
+    VALUE y_max;
+} Box;
+
+/* Open-addressing map from pointers to ints, used
+ * to tag faces, edges and points during an update
+ */
+typedef struct
+{
+    const void **keys;
+    size_t *vals;
+    size_t cap;
+    size_t count;
+} PtrMap;
+
+enum { FACE_CAVITY = 1, FACE_KEPT = 2 };
+
+typedef struct
+{
+    Edge **data;
+    size_t size;
+    size_t cap;
+} EdgeStack;
+
+typedef struct
+{
+    Point **data;
+    size_t size;
+    size_t cap;
+} PointStack;
+
+/***********************************
+ * CONTAINERS **********************
+ ***********************************/
+
+static void initMap(PtrMap *m, size_t hint)
+{
+    m->cap = 16;
+    while (m->cap < 2 * hint) m->cap <<= 1;
+    m->keys = calloc(m->cap, sizeof *(m->keys));
+    m->vals = malloc(m->cap * sizeof *(m->vals));
+    m->count = 0;
+}
+
+static void freeMap(PtrMap *m)
+{
+    free(m->keys);
+    free(m->vals);
+}
+
+static size_t hashPtr(const void *k, size_t cap)
+{
+    uint64_t h = (uint64_t)(uintptr_t)k;
+    h ^= h >> 29;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (cap - 1);
+}
+
+static size_t *mapGet(PtrMap *m, const void *k)
+{
+    size_t i = hashPtr(k, m->cap);
+    while (m->keys[i])
+    {
+        if (m->keys[i] == k) return m->vals + i;
+        i = (i + 1) & (m->cap - 1);
+    }
+    return NULL;
+}
+
+static void mapPut(PtrMap *m, const void *k, size_t v);
+
+static void growMap(PtrMap *m)
+{
+    PtrMap old = *m;
+    m->cap <<= 1;
+    m->keys = calloc(m->cap, sizeof *(m->keys));
+    m->vals = malloc(m->cap * sizeof *(m->vals));
+    m->count = 0;
+    for (size_t i = 0; i < old.cap; i++)
+    {
+        if (old.keys[i]) mapPut(m, old.keys[i], old.vals[i]);
+    }
+    freeMap(&old);
+}
+
+static void mapPut(PtrMap *m, const void *k, size_t v)
+{
+    if (2 * (m->count + 1) > m->cap) growMap(m);
+
+    size_t i = hashPtr(k, m->cap);
+    while (m->keys[i] && m->keys[i] != k) i = (i + 1) & (m->cap - 1);
+    if (!m->keys[i]) m->count++;
+    m->keys[i] = k;
+    m->vals[i] = v;
+}
+
+static void push(EdgeStack *s, Edge *e)
+{
+    if (s->size == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 64;
+        s->data = realloc(s->data, s->cap * sizeof *(s->data));
+    }
+    (s->data)[(s->size)++] = e;
+}
+
+static void pushPoint(PointStack *s, Point *p)
+{
+    if (s->size == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 64;
+        s->data = realloc(s->data, s->cap * sizeof *(s->data));
+    }
+    (s->data)[(s->size)++] = p;
+}
+
+/***********************************
+ * GEOMETRY ************************
+ ***********************************/
+
+static int inBox(Point *p, const Box *b)
+{
+    return (p->x >= b->x_min) && (p->x <= b->x_max) && (p->y >= b->y_min) && (p->y <= b->y_max);
+}
+
+/* Number a cavity vertex the first time it is seen:
+ * vertices inside the region are removed, the others
+ * are kept and indexed into the local triangulation
+ */
+static void tagVertex(Point *p, const Box *region, PtrMap *vertices,
+                      PointStack *removed, PointStack *kept)
+{
+    if (mapGet(vertices, p)) return;
+    if (inBox(p, region))
+    {
+        mapPut(vertices, p, SIZE_MAX);
+        pushPoint(removed, p);
+    }
+    else
+    {
+        mapPut(vertices, p, kept->size);
+        pushPoint(kept, p);
+    }
+}
+
+/* Faces are keyed by their smallest edge,
+ * ghost faces by their hull edge
+ */
+static Edge *faceKey(Edge *e)
+{
+    if (!isTriangle(e)) return e;
+
+    Edge *key = e;
+    if (e->dnext < key) key = e->dnext;
+    if (e->dnext->dnext < key) key = e->dnext->dnext;
+    return key;
+}
+
+/* Conservative: errs towards reporting a hit,
+ * which only makes the cavity larger
+ */
+static int circleMeetsBox(Edge *e, const Box *b)
+{
+    Point *p = e->orig;
+    Point *q = e->dnext->orig;
+    Point *r = e->dnext->dnext->orig;
+    if (inBox(p, b) || inBox(q, b) || inBox(r, b)) return 1;
+
+    double qx = (double)(q->x - p->x);
+    double qy = (double)(q->y - p->y);
+    double rx = (double)(r->x - p->x);
+    double ry = (double)(r->y - p->y);
+    double d = 2.0 * (qx * ry - qy * rx);
+    double q2 = qx * qx + qy * qy;
+    double r2 = rx * rx + ry * ry;
+    double ux = (ry * q2 - qy * r2) / d;
+    double uy = (qx * r2 - rx * q2) / d;
+    double radius2 = ux * ux + uy * uy;
+    ux += (double)p->x;
+    uy += (double)p->y;
+
+    double dx = (ux < b->x_min) ? b->x_min - ux : ((ux > b->x_max) ? ux - b->x_max : 0.0);
+    double dy = (uy < b->y_min) ? b->y_min - uy : ((uy > b->y_max) ? uy - b->y_max : 0.0);
+
+    return dx * dx + dy * dy <= radius2 * (1.0 + 1e-9) + 1e-6;
+}
+
+/* Outer face lies to the right of hull edge h
+ */
+static int halfPlaneMeetsBox(Edge *h, const Box *b)
+{
+    Point corners[4] = {
+        {b->x_min, b->y_min, NULL}, {b->x_max, b->y_min, NULL},
+        {b->x_max, b->y_max, NULL}, {b->x_min, b->y_max, NULL}
+    };
+    for (int i = 0; i < 4; i++)
+    {
+        if (orientation(h->orig, h->twin->orig, corners + i) <= 0) return 1;
+    }
+    return 0;
+}
+
+/* Decide whether face g (right of edge g), reached
+ * from cavity face f, also belongs to the cavity.
+ * Cocircular pairs only count when both are triangles
+ */
+static int inCavity(Edge *f, Edge *g, const Box *b)
+{
+    if (!isTriangle(g)) return halfPlaneMeetsBox(g, b);
+    if (circleMeetsBox(g, b)) return 1;
+    if (!isTriangle(f)) return 0;
+
+    // f is clockwise, so reverse for inCircle
+    Point *apex = g->dnext->twin->orig;
+    return cocircular(f->orig, f->dnext->dnext->orig, f->dnext->orig, apex);
+}
+
+/* Visibility walk to the face containing q.
+ * Returns an edge with that face on its right,
+ * or a hull edge with q on its outer side
+ */
+static Edge *locateFace(Edge *e, Point *q)
+{
+    if (orientation(e->orig, e->twin->orig, q) > 0) e = e->twin;
+    while (1)
+    {
+        if (!isTriangle(e)) return e;
+
+        Edge *f = e->dnext;
+        Edge *g = f->dnext;
+        if (orientation(f->orig, f->twin->orig, q) > 0) e = f->twin;
+        else if (orientation(g->orig, g->twin->orig, q) > 0) e = g->twin;
+        else return e;
+    }
+}
+
+/***********************************
+ * UPDATE **************************
+ ***********************************/
+
+/* Which new points to insert: the first of each
+ * distinct one that is not at a kept point already,
+ * so the triangulation never sees a duplicate
+ */
+static char *freshPoints(Point *kept[], size_t num_kept, Point new_points[], size_t num_new)
+{
+    size_t n = num_kept + num_new;
+    Point *all = malloc(n * sizeof *all);
+    for (size_t t = 0; t < num_kept; t++) all[t] = (Point){kept[t]->x, kept[t]->y, NULL};
+    for (size_t t = 0; t < num_new; t++) all[num_kept + t] = (Point){new_points[t].x, new_points[t].y, NULL};
+
+    Point **unique = malloc(n * sizeof *unique);
+    size_t *representative = malloc(n * sizeof *representative);
+    removeDuplicates(all, n, unique, representative);
+
+    char *fresh = malloc(num_new);
+    for (size_t t = 0; t < num_new; t++) fresh[t] = (representative[num_kept + t] == num_kept + t);
+
+    free(representative);
+    free(unique);
+    free(all);
+    return fresh;
+}
+
+/* Used when the mesh is too small to have a cavity
+ * worth the name: clear it and triangulate again
+ */
+static size_t rebuildAll(const Box *region, Point new_points[], size_t num_new,
+                         PointList *point_list, EdgeList *edge_list)
+{
+    size_t removed = 0;
+    size_t num_live = point_list->size - point_list->idx;
+    Point **live = malloc((num_live + num_new) * sizeof *live);
+    size_t n = 0;
+
+    // A point is live iff it is not on the unused stack
+    char *unused = calloc(point_list->size, 1);
+    for (size_t t = 0; t < point_list->idx; t++) unused[(point_list->unused_points)[t] - point_list->points] = 1;
+
+    for (size_t t = 0; t < point_list->size; t++)
+    {
+        Point *p = point_list->points + t;
+        if (unused[t]) continue;
+        while (p->e) destroyEdge(p->e, edge_list);
+        if (inBox(p, region))
+        {
+            destroyPoint(p, point_list, edge_list);
+            removed++;
+        }
+        else live[n++] = p;
+    }
+    free(unused);
+
+    char *fresh = freshPoints(live, n, new_points, num_new);
+    for (size_t t = 0; t < num_new; t++)
+    {
+        if (fresh[t]) live[n++] = makePoint(new_points[t].x, new_points[t].y, point_list);
+    }
+    free(fresh);
+
+    if (n >= 2) free(delaunay_horizontal(live, n, edge_list));
+    free(live);
+
+    return removed;
+}
+
+/* Remove every point inside the box [x_min, x_max] x [y_min, y_max]
+ * and insert new_points (which should lie inside the box),
+ * updating the triangulation in place. Only the part of the
+ * mesh near the box is touched. Repeated new points, and new
+ * points at a point kept outside the box, are skipped.
+ * The point and edge lists must have room for the new points.
+ * Returns the number of points removed.
+ */
+size_t replaceRegion(VALUE x_min, VALUE y_min, VALUE x_max, VALUE y_max,
+                     Point new_points[], size_t num_new,
+                     PointList *point_list, EdgeList *edge_list)
+{
+    Box region = {x_min, y_min, x_max, y_max};
+
+    // Box touched by the update: the region plus any stray new points
+    Box touched = region;
+    for (size_t t = 0; t < num_new; t++)
+    {
+        if (new_points[t].x < touched.x_min) touched.x_min = new_points[t].x;
+        if (new_points[t].x > touched.x_max) touched.x_max = new_points[t].x;
+        if (new_points[t].y < touched.y_min) touched.y_min = new_points[t].y;
+        if (new_points[t].y > touched.y_max) touched.y_max = new_points[t].y;
+    }
+
+    // Find a starting edge
+    Edge *start = NULL;
+    for (size_t t = 0; t < point_list->size && start == NULL; t++)
+    {
+        Point *p = point_list->points + t;
+        if (p->e) start = p->e;
+    }
+    if (start == NULL || point_list->size - point_list->idx < 3)
+    {
+        return rebuildAll(&region, new_points, num_new, point_list, edge_list);
+    }
+
+    // Grow the cavity outwards from the face containing the box centre
+    Point centre = {touched.x_min + (touched.x_max - touched.x_min) / 2, touched.y_min + (touched.y_max - touched.y_min) / 2, NULL};
+    Edge *seed = locateFace(start, &centre);
+
+    PtrMap faces;
+    initMap(&faces, 64);
+    EdgeStack cavity = {NULL, 0, 0};
+    EdgeStack todo = {NULL, 0, 0};
+
+    mapPut(&faces, faceKey(seed), FACE_CAVITY);
+    push(&cavity, seed);
+    push(&todo, seed);
+    while (todo.size)
+    {
+        Edge *f = todo.data[--todo.size];
+
+        Edge *across[3];
+        size_t num_across = 0;
+        if (isTriangle(f))
+        {
+            across[num_across++] = f->twin;
+            across[num_across++] = f->dnext->twin;
+            across[num_across++] = f->dnext->dnext->twin;
+        }
+        else
+        {
+            across[num_across++] = f->twin;
+            across[num_across++] = f->dnext;
+            across[num_across++] = f->oprev;
+        }
+
+        for (size_t i = 0; i < num_across; i++)
+        {
+            Edge *g = across[i];
+            Edge *key = faceKey(g);
+            size_t *state = mapGet(&faces, key);
+            if (state && *state == FACE_CAVITY) continue;
+
+            if (inCavity(f, g, &touched))
+            {
+                mapPut(&faces, key, FACE_CAVITY);
+                push(&cavity, g);
+                push(&todo, g);
+            }
+            else if (!state) mapPut(&faces, key, FACE_KEPT);
+        }
+    }
+
+    // Sort cavity edges into doomed interior edges and boundary
+    // edges (stored with the kept face on their right), and
+    // number the surviving cavity vertices
+    PtrMap vertices;
+    initMap(&vertices, cavity.size);
+    EdgeStack doomed = {NULL, 0, 0};
+    EdgeStack boundary = {NULL, 0, 0};
+    PointStack removed = {NULL, 0, 0};
+    PointStack kept = {NULL, 0, 0};
+
+    for (size_t c = 0; c < cavity.size; c++)
+    {
+        Edge *f = cavity.data[c];
+        size_t sides = isTriangle(f) ? 3 : 1;
+        for (size_t i = 0; i < sides; i++, f = f->dnext)
+        {
+            tagVertex(f->orig, &region, &vertices, &removed, &kept);
+            if (!isTriangle(f))
+            {
+                // Ghosts contribute both hull vertices
+                tagVertex(f->twin->orig, &region, &vertices, &removed, &kept);
+            }
+
+            size_t *other = mapGet(&faces, faceKey(f->twin));
+            if (*other == FACE_CAVITY)
+            {
+                if (f < f->twin) push(&doomed, f);
+            }
+            else push(&boundary, f->twin);
+        }
+    }
+    freeMap(&faces);
+    free(cavity.data);
+    free(todo.data);
+
+    // Boundary edges only need their endpoints from here on
+    size_t num_boundary = boundary.size;
+    Point **boundary_points = malloc(2 * num_boundary * sizeof *boundary_points);
+    for (size_t t = 0; t < num_boundary; t++)
+    {
+        boundary_points[2 * t] = boundary.data[t]->orig;
+        boundary_points[2 * t + 1] = boundary.data[t]->twin->orig;
+    }
+    free(boundary.data);
+
+    // Carve out the cavity
+    for (size_t t = 0; t < doomed.size; t++) destroyEdge(doomed.data[t], edge_list);
+    free(doomed.data);
+    for (size_t t = 0; t < removed.size; t++) destroyPoint(removed.data[t], point_list, edge_list);
+    free(removed.data);
+
+    char *fresh = freshPoints(kept.data, kept.size, new_points, num_new);
+    for (size_t t = 0; t < num_new; t++)
+    {
+        if (fresh[t]) pushPoint(&kept, makePoint(new_points[t].x, new_points[t].y, point_list));
+    }
+    free(fresh);
+    Point **local_to_main = kept.data;
+    size_t num_local = kept.size;
+
+    // Triangulate cavity vertices on their own
+    Point *local = malloc(num_local * sizeof *local);
+    Point **local_ptrs = malloc(num_local * sizeof *local_ptrs);
+    for (size_t t = 0; t < num_local; t++)
+    {
+        local[t].x = local_to_main[t]->x;
+        local[t].y = local_to_main[t]->y;
+        local[t].e = NULL;
+        local_ptrs[t] = local + t;
+    }
+    EdgeList *local_edges = initializeEdgeList(num_local);
+    if (num_local >= 2) free(delaunay_horizontal(local_ptrs, num_local, local_edges));
+
+    // Collect local edges lying inside the cavity
+    EdgeStack keep = {NULL, 0, 0};
+    if (num_boundary == 0)
+    {
+        // Nothing kept, so everything is new
+        for (size_t t = 0; t < num_local; t++)
+        {
+            Edge *e = local[t].e;
+            Edge *f = e;
+            if (f == NULL) continue;
+            do {
+                if (compareXY(f->orig, f->twin->orig)) push(&keep, f);
+                f = f->twin->dnext;
+            } while (f != e);
+        }
+    }
+    else
+    {
+        PtrMap barrier;
+        PtrMap seen;
+        PtrMap taken;
+        initMap(&barrier, 2 * num_boundary);
+        initMap(&seen, 4 * num_local);
+        initMap(&taken, 6 * num_local);
+        EdgeStack flood = {NULL, 0, 0};
+
+        for (size_t t = 0; t < num_boundary; t++)
+        {
+            Point *a = local + *mapGet(&vertices, boundary_points[2 * t]);
+            Point *b = local + *mapGet(&vertices, boundary_points[2 * t + 1]);
+
+            Edge *e = a->e;
+            Edge *f = e;
+            while (f->twin->orig != b)
+            {
+                f = f->twin->dnext;
+                if (f == e)
+                {
+                    printf("Something has gone very wrong.\nCavity boundary missing from local triangulation.\nExiting...\n");
+                    exit(1);
+                }
+            }
+
+            mapPut(&barrier, f, 1);
+            mapPut(&barrier, f->twin, 1);
+            push(&flood, f->twin);
+        }
+
+        while (flood.size)
+        {
+            Edge *f = flood.data[--flood.size];
+            if (!isTriangle(f)) continue;
+
+            Edge *key = faceKey(f);
+            if (mapGet(&seen, key)) continue;
+            mapPut(&seen, key, 1);
+
+            for (int i = 0; i < 3; i++, f = f->dnext)
+            {
+                if (mapGet(&barrier, f)) continue;
+                if (!mapGet(&taken, f->twin))
+                {
+                    mapPut(&taken, f, 1);
+                    push(&keep, f);
+                }
+                push(&flood, f->twin);
+            }
+        }
+
+        freeMap(&barrier);
+        freeMap(&seen);
+        freeMap(&taken);
+        free(flood.data);
+    }
+
+    // Stitch into the surrounding mesh
+    for (size_t t = 0; t < keep.size; t++)
+    {
+        Edge *f = keep.data[t];
+        insertEdge(local_to_main[f->orig - local], local_to_main[f->twin->orig - local], edge_list);
+    }
+
+    free(keep.data);
+    freeEdges(local_edges);
+    free(local_edges);
+    free(local);
+    free(local_ptrs);
+    free(local_to_main);
+    free(boundary_points);
+    freeMap(&vertices);
+
+    return removed.size;
+}
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "defs.h"
+#include "run.h"
+#include "delaunay.h"
+#include "levels.h"
+#include "topology.h"
+#include "trimesh.h"
+#include "stream.h"
+#include "filter.h"
+#include "dedup.h"
+#include "verify.h"
+#include "graph.h"
+#include "constrain.h"
+#include "hull.h"
+#include "simplify.h"
+#include "io.h"
+#include "helper.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* This file is built once per coordinate width,
+ * see NARROW_COORDS in defs.h
+ */
+#ifdef NARROW_COORDS
+#define RUN_VARIANT runNarrow
+#define TILE_VARIANT runTileNarrow
+#define FREE_WORKSPACE_VARIANT freeWorkspaceNarrow
+#else
+#define RUN_VARIANT runWide
+#define TILE_VARIANT runTileWide
+#define FREE_WORKSPACE_VARIANT freeWorkspaceWide
+#endif
+
+/* Arenas of one batch worker, kept between tiles
+ * and only grown when a tile needs more room
+ */
+struct Workspace
+{
+    size_t capacity;
+    PointList *point_list;
+    EdgeList *edge_list;
+    Point **point_ptr_list;
+};
+
+static void writeFiltered(PointList *point_list, EdgeList *edge_list, const Options *options)
+{
+    Filter filter = {options->max_edge, options->alpha};
+
+    FILE *boundary_out = NULL;
+    if (options->boundary)
+    {
+        boundary_out = fopen(options->boundary, "w");
+        if (boundary_out == NULL)
+        {
+            printf("Failed to open %s\n", options->boundary);
+            exit(1);
+        }
+    }
+
+    writeFilteredEdges(point_list, edge_list, &filter, stdout, boundary_out);
+
+    if (boundary_out) fclose(boundary_out);
+}
+
+/* Write the EMST or the k nearest neighbours
+ * instead of the triangulation
+ */
+static void writeGraph(PointList *point_list, Point *point_ptr_list[], size_t num_points,
+                       EdgeList *edge_list, const Options *options)
+{
+    double start = seconds();
+
+    Edge **tree = NULL;
+    size_t num_tree_edges = 0;
+    Point **neighbours = NULL;
+    #pragma omp parallel
+    #pragma omp single
+    {
+        if (options->emst) tree = spanningTree(point_list, edge_list, &num_tree_edges);
+        else neighbours = nearestNeighbours(point_list, point_ptr_list, num_points, (size_t)options->knn);
+    }
+
+    if (options->timing) fprintf(stderr, "%s: %.3f s\n", options->emst ? "emst" : "knn", seconds() - start);
+
+    if (tree) writeSpanningTree(point_list, tree, num_tree_edges, stdout);
+    else writeNearestNeighbours(point_list, neighbours, (size_t)options->knn, stdout);
+
+    free(tree);
+    free(neighbours);
+}
+
+/* Write each dropped duplicate with the index
+ * of the point kept in its place
+ */
+static void writeDuplicates(size_t *representative, size_t num_points, const char *filename)
+{
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        printf("Failed to open %s\n", filename);
+        exit(1);
+    }
+
+    for (size_t t = 0; t < num_points; t++)
+    {
+        if (representative[t] != t) fprintf(out, "%zu %zu\n", t, representative[t]);
+    }
+    fclose(out);
+}
+
+/* Check the triangulation before it is written,
+ * and stop if it fails
+ */
+static void verifyEdges(Point *point_ptr_list[], size_t num_points, EdgeList *edge_list, const Options *options)
+{
+    double start = seconds();
+
+    Verification v;
+    int ok = verifyTriangulation(point_ptr_list, num_points, edge_list, &v);
+
+    if (options->timing) fprintf(stderr, "verify: %.3f s\n", seconds() - start);
+    fprintf(stderr, "verify: %s, %zu vertices, %zu edges, %zu triangles, %zu hull edges\n",
+            ok ? "ok" : "FAILED", v.vertices, v.edges, v.triangles, v.hull_edges);
+    if (ok) return;
+
+    fprintf(stderr, "verify: %zu broken links, %zu edges not locally Delaunay, %zu hull errors, Euler's formula %s\n",
+            v.bad_links, v.not_delaunay, v.bad_hull, v.euler ? "holds" : "fails");
+    printf("Triangulation failed verification\nExiting...\n");
+    exit(1);
+}
+
+static void runEdges(PointList *point_list, size_t num_points, const Options *options)
+{
+    double start = seconds();
+
+    EdgeList *edge_list = initializeEdgeList(num_points);
+
+    // Only the first of each set of duplicates is
+    // triangulated, the others are left without edges
+    Point **point_ptr_list = malloc(num_points * sizeof *point_ptr_list);
+    int keep = options->duplicates || options->constraints;
+    size_t *representative = keep ? malloc(num_points * sizeof *representative) : NULL;
+    size_t num_unique = removeDuplicates(point_list->points, num_points, point_ptr_list, representative);
+    if (options->duplicates) writeDuplicates(representative, num_points, options->duplicates);
+
+    // Segments end at the points kept
+    size_t num_segments = 0;
+    size_t *segments = NULL;
+    if (options->constraints)
+    {
+        segments = readSegments(options->constraints, num_points, &num_segments);
+        for (size_t t = 0; t < 2 * num_segments; t++) segments[t] = representative[segments[t]];
+    }
+    free(representative);
+
+    // Final edges are written by another thread
+    // while the merges go on, see stream.c.
+    // Constraints change edges after the merges, and
+    // nothing may be written before the check passes
+    int filtered = options->max_edge > 0 || options->alpha > 0;
+    int graph = options->emst || options->knn > 0;
+    int streamed = options->pipeline && !filtered && !graph && !segments && !options->verify;
+    Stream *stream = streamed ? openStream(point_list, edge_list, stdout) : NULL;
+
+    // Halves and seams are spread over the threads
+    // as tasks, see delaunay.c and seam.c
+    // Fewer than two distinct points have no edges
+    ExtremeEdge *ex = NULL;
+    LevelStats *stats = NULL;
+    size_t num_levels = 0;
+    #pragma omp parallel if(num_unique >= 2)
+    #pragma omp single
+    {
+        if (num_unique < 2) ex = NULL;
+        else if (options->levels) ex = delaunayLevels(point_ptr_list, num_unique, edge_list, &stats, &num_levels);
+        else if (stream) ex = delaunayStreamed(point_ptr_list, num_unique, edge_list, stream);
+        else ex = delaunay_horizontal(point_ptr_list, num_unique, edge_list);
+    }
+
+    if (options->timing)
+    {
+        fprintf(stderr, "edge backend: %.3f s\n", seconds() - start);
+        for (size_t d = 0; d < num_levels; d++)
+        {
+            fprintf(stderr, "  level %zu: %zu merges, %zu leaves, split %.3f s, merge %.3f s\n", d,
+                    stats[d].merges, stats[d].leaves, stats[d].split_seconds, stats[d].merge_seconds);
+        }
+    }
+    free(stats);
+
+    if (segments)
+    {
+        start = seconds();
+        insertSegments(point_list->points, segments, num_segments, edge_list);
+        if (options->timing) fprintf(stderr, "constraints: %.3f s\n", seconds() - start);
+        free(segments);
+    }
+
+    if (options->verify) verifyEdges(point_ptr_list, num_unique, edge_list, options);
+
+    if (stream) closeStream(stream);
+    else if (graph) writeGraph(point_list, point_ptr_list, num_unique, edge_list, options);
+    else if (filtered) writeFiltered(point_list, edge_list, options);
+    else showEdges(point_list);
+
+    free(ex);
+
+    freeEdges(edge_list);
+    free(edge_list);
+    free(point_ptr_list);
+}
+
+/* Only the convex hull, from the same cuts as
+ * the edge backend
+ */
+static void runHull(PointList *point_list, size_t num_points, const Options *options)
+{
+    double start = seconds();
+
+    Point **point_ptr_list = malloc(num_points * sizeof *point_ptr_list);
+    size_t *representative = options->duplicates ? malloc(num_points * sizeof *representative) : NULL;
+    size_t num_unique = removeDuplicates(point_list->points, num_points, point_ptr_list, representative);
+    if (representative)
+    {
+        writeDuplicates(representative, num_points, options->duplicates);
+        free(representative);
+    }
+
+    size_t hull_size = 0;
+    #pragma omp parallel if(num_unique >= 2)
+    #pragma omp single
+    hull_size = convexHull(point_ptr_list, num_unique);
+
+    if (options->timing) fprintf(stderr, "hull: %.3f s\n", seconds() - start);
+
+    writeHull(point_list, point_ptr_list, hull_size, stdout);
+
+    free(point_ptr_list);
+}
+
+/* A triangulation of as few of the points as keeps
+ * every height within the tolerance
+ */
+static void runSimplify(PointList *point_list, const double *heights, size_t num_points, const Options *options)
+{
+    double start = seconds();
+
+    Point **point_ptr_list = malloc(num_points * sizeof *point_ptr_list);
+    size_t *representative = options->duplicates ? malloc(num_points * sizeof *representative) : NULL;
+    size_t num_unique = removeDuplicates(point_list->points, num_points, point_ptr_list, representative);
+    if (representative)
+    {
+        writeDuplicates(representative, num_points, options->duplicates);
+        free(representative);
+    }
+
+    TriangleList *triangle_list;
+    int *chain;
+    size_t chain_size;
+    size_t num_kept;
+    #pragma omp parallel
+    #pragma omp single
+    triangle_list = simplifyTerrain(point_list->points, heights, point_ptr_list, num_unique, options->simplify,
+                                    &chain, &chain_size, &num_kept);
+
+    if (options->timing)
+    {
+        fprintf(stderr, "simplify: %.3f s, %zu of %zu points kept, %zu triangles\n",
+                seconds() - start, num_kept, num_unique, triangle_list->idx);
+    }
+
+    showTriangleEdges(triangle_list, point_list, chain, chain_size);
+
+    free(chain);
+    freeTriangles(triangle_list);
+    free(triangle_list);
+    free(point_ptr_list);
+}
+
+static void runTriangles(PointList *point_list, size_t num_points, const Options *options)
+{
+    double start = seconds();
+
+    int *chain;
+    size_t chain_size;
+    TriangleList *triangle_list = triangulateTriangles(point_list->points, num_points, &chain, &chain_size);
+
+    if (options->timing) fprintf(stderr, "triangle backend: %.3f s\n", seconds() - start);
+
+    showTriangleEdges(triangle_list, point_list, chain, chain_size);
+
+    free(chain);
+    freeTriangles(triangle_list);
+    free(triangle_list);
+}
+
+void RUN_VARIANT(long *xy, const double *original, const double *heights, size_t num_points,
+                 const Options *options)
+{
+#ifdef _OPENMP
+    if (options->threads > 0) omp_set_num_threads(options->threads);
+#endif
+
+    PointList *point_list = initializePointList(num_points);
+    for (size_t t = 0; t < num_points; t++)
+    {
+        makePoint((VALUE)xy[2 * t], (VALUE)xy[2 * t + 1], point_list);
+    }
+    free(xy);
+    point_list->original = original;
+
+    if (options->hull) runHull(point_list, num_points, options);
+    else if (options->simplify > 0) runSimplify(point_list, heights, num_points, options);
+    else if (options->backend == BACKEND_TRIANGLE) runTriangles(point_list, num_points, options);
+    else runEdges(point_list, num_points, options);
+
+    freePoints(point_list);
+    free(point_list);
+}
+
+static void releaseArenas(Workspace *ws)
+{
+    if (ws->capacity == 0) return;
+
+    freePoints(ws->point_list);
+    free(ws->point_list);
+    freeEdges(ws->edge_list);
+    free(ws->edge_list);
+    free(ws->point_ptr_list);
+}
+
+/* Make the arenas of a workspace ready for
+ * num_points, creating or growing them if needed
+ */
+static Workspace *prepareWorkspace(Workspace **workspace, size_t num_points)
+{
+    if (*workspace == NULL) *workspace = calloc(1, sizeof **workspace);
+    Workspace *ws = *workspace;
+
+    if (num_points <= ws->capacity)
+    {
+        resetPointList(ws->point_list, num_points);
+        resetEdgeList(ws->edge_list, num_points);
+        return ws;
+    }
+
+    releaseArenas(ws);
+    ws->capacity = num_points;
+    ws->point_list = initializePointList(num_points);
+    ws->edge_list = initializeEdgeList(num_points);
+    ws->point_ptr_list = malloc(num_points * sizeof *(ws->point_ptr_list));
+
+    return ws;
+}
+
+/* Triangulate one tile of a batch (see batch.c)
+ * with the edge backend and write its edges to out.
+ * Takes ownership of xy. Called from a task, so
+ * large tiles spread their halves over the team
+ */
+void TILE_VARIANT(long *xy, size_t num_points, FILE *out, Workspace **workspace)
+{
+    if (num_points < 2)
+    {
+        free(xy);
+        return;
+    }
+
+    Workspace *ws = prepareWorkspace(workspace, num_points);
+    for (size_t t = 0; t < num_points; t++)
+    {
+        makePoint((VALUE)xy[2 * t], (VALUE)xy[2 * t + 1], ws->point_list);
+    }
+    free(xy);
+
+    size_t num_unique = removeDuplicates(ws->point_list->points, num_points, ws->point_ptr_list, NULL);
+    if (num_unique < 2) return;
+
+    ExtremeEdge *ex = delaunay_horizontal(ws->point_ptr_list, num_unique, ws->edge_list);
+    writeEdges(ws->point_list, out);
+    free(ex);
+}
+
+void FREE_WORKSPACE_VARIANT(Workspace *workspace)
+{
+    if (workspace == NULL) return;
+
+    releaseArenas(workspace);
+    free(workspace);
+}
@@ -0,0 +1,377 @@
+#include <stdlib.h>
+#include "seam.h"
+#include "delaunay.h"
+#include "topology.h"
+#include "helper.h"
+
+/* Zipping the seam of a merge, in pieces.
+ *
+ * The crossing edges of a merge are added one after
+ * another from the lower common tangent, which leaves
+ * the seams of the last few merges as the only serial
+ * work once the halves are triangulated in parallel.
+ *
+ * A pair of points, one from each half, each nearest
+ * to the other among the other half, has a circle on
+ * it as diameter holding no other point, so the edge
+ * between them is in every Delaunay triangulation of
+ * the merged points. Such 'seeds' are found in bands
+ * across the seam by walking the two triangulations,
+ * and inserted up front (after detaching the edges
+ * they cross at their far end). Each stretch of seam
+ * between seeds is then zipped by its own task, with
+ * nextCrossEdgeBefore stopping at the next seed.
+ *
+ * Only the seed endpoints are shared by two stretches,
+ * and each stretch rotates about them on its own side
+ * of the seed, so the stretches touch disjoint links.
+ *
+ * Vertical merges are handled in the frame (y, -x), in
+ * which the bottom half is on the left and the seam is
+ * zipped upwards, as for horizontal ones.
+ */
+
+// Merges of fewer points zip their seam in one pass
+#define SEAM_MIN_POINTS (1 << 16)
+
+// Seeds are only looked for while squared distances
+// across the merged hull fit comfortably in POWER
+#define SEAM_MAX_SPAN ((POWER)1 << 61)
+
+typedef struct
+{
+    int vertical;
+    Point *split;       // least point of the second half
+    Point *first_near;  // hull vertices closest to the cut
+    Point *second_near;
+    POWER cut;
+} Cut;
+
+typedef struct
+{
+    Edge **data;
+    size_t size;
+    size_t cap;
+} EdgeStack;
+
+static void push(EdgeStack *s, Edge *e)
+{
+    if (s->size == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 64;
+        s->data = realloc(s->data, s->cap * sizeof *(s->data));
+    }
+    (s->data)[(s->size)++] = e;
+}
+
+/***********************************
+ * GEOMETRY ************************
+ ***********************************/
+
+static int inFirst(const Cut *cut, Point *p)
+{
+    return cut->vertical ? compareYX(p, cut->split) : compareXY(p, cut->split);
+}
+
+// Coordinate across the cut
+static POWER across(int vertical, Point *p)
+{
+    return vertical ? (POWER)p->y : (POWER)p->x;
+}
+
+// Coordinate along the cut, increasing up the seam
+static POWER along(int vertical, Point *p)
+{
+    return vertical ? -(POWER)p->x : (POWER)p->y;
+}
+
+static POWER distance2(Point *p, POWER x, POWER y)
+{
+    POWER dx = p->x - x;
+    POWER dy = p->y - y;
+    return dx * dx + dy * dy;
+}
+
+/* Walk from p to the point of its half nearest
+ * (x, y), always stepping to a closer neighbour.
+ * In a Delaunay triangulation the walk can only
+ * stop at a nearest point
+ */
+static Point *nearestPoint(const Cut *cut, Point *p, POWER x, POWER y)
+{
+    int first = inFirst(cut, p);
+    POWER best = distance2(p, x, y);
+
+    int moved = 1;
+    while (moved)
+    {
+        moved = 0;
+        Edge *e = p->e;
+        Edge *f = e;
+        do
+        {
+            Point *q = f->twin->orig;
+            if (inFirst(cut, q) == first)
+            {
+                POWER d = distance2(q, x, y);
+                if (d < best)
+                {
+                    best = d;
+                    p = q;
+                    moved = 1;
+                    break;
+                }
+            }
+            f = f->twin->dnext;
+        } while (f != e);
+    }
+
+    return p;
+}
+
+/* Starting from the points nearest (x, y), alternate
+ * nearest point walks across the cut until both ends
+ * of the pair are nearest to each other. The distance
+ * drops with every round, so this ends
+ */
+static void nearestPair(const Cut *cut, POWER x, POWER y, Point **first, Point **second)
+{
+    Point *l = nearestPoint(cut, cut->first_near, x, y);
+    Point *r = cut->second_near;
+
+    while (1)
+    {
+        r = nearestPoint(cut, r, l->x, l->y);
+        POWER d = distance2(r, l->x, l->y);
+
+        Point *l_next = nearestPoint(cut, l, r->x, r->y);
+        if (distance2(l_next, r->x, r->y) == d) break;
+        l = l_next;
+    }
+
+    *first = l;
+    *second = r;
+}
+
+/* Push the edges of from's half crossed by the
+ * segment from -> to, walking the triangles it
+ * passes through until it leaves that half
+ */
+static void collectCrossings(Point *from, Point *to, EdgeStack *crossings)
+{
+    Edge *g = ringSuccessor(from, to);
+    if (!isTriangle(g)) return;
+
+    Edge *h = g->dnext;
+    while (1)
+    {
+        push(crossings, h);
+
+        // Leave the triangle beyond h through
+        // the side that separates from and to
+        Edge *t = h->twin;
+        if (!isTriangle(t)) return;
+
+        Point *w = t->dnext->twin->orig;
+        if (orientation(from, to, w) == orientation(from, to, h->orig)) h = t->dnext->dnext;
+        else h = t->dnext;
+    }
+}
+
+/***********************************
+ * ZIPPING *************************
+ ***********************************/
+
+static Edge *zipStretch(Edge *base, Edge *stop, EdgeList *edge_list)
+{
+    Edge *top = base;
+    Edge *next;
+    while ((next = nextCrossEdgeBefore(top, stop, edge_list)) != NULL) top = next;
+    return top;
+}
+
+/* Find up to num_bands seeds, one per band across
+ * the seam, in order up the seam. Returns the count
+ */
+static size_t findSeeds(const Cut *cut, Edge *base, POWER along_min, POWER along_max,
+                        size_t num_bands, Point **seeds)
+{
+    POWER width = (along_max - along_min) / (POWER)num_bands + 1;
+
+    #pragma omp taskloop grainsize(1)
+    for (size_t k = 0; k < num_bands; k++)
+    {
+        POWER lo = along_min + (POWER)k * width;
+        POWER hi = lo + width;
+        POWER mid = lo + width / 2;
+
+        POWER x = cut->vertical ? -mid : cut->cut;
+        POWER y = cut->vertical ? cut->cut : mid;
+
+        Point *l;
+        Point *r;
+        nearestPair(cut, x, y, &l, &r);
+
+        // Both ends inside the band keeps seeds
+        // from different bands in seam order
+        int inside = along(cut->vertical, l) >= lo && along(cut->vertical, l) < hi &&
+                     along(cut->vertical, r) >= lo && along(cut->vertical, r) < hi;
+        int tangent = (l == base->twin->orig) && (r == base->orig);
+
+        seeds[2 * k] = (inside && !tangent) ? l : NULL;
+        seeds[2 * k + 1] = r;
+    }
+
+    size_t num_seeds = 0;
+    for (size_t k = 0; k < num_bands; k++)
+    {
+        if (seeds[2 * k] == NULL) continue;
+        seeds[2 * num_seeds] = seeds[2 * k];
+        seeds[2 * num_seeds + 1] = seeds[2 * k + 1];
+        num_seeds++;
+    }
+    return num_seeds;
+}
+
+/* Insert the R-L seed edges, first detaching every
+ * edge they cross from its end above the seed, so
+ * that the stretch below still finds it in place
+ * and the stretch above finds it gone.
+ * Detached edges stay allocated until the stretch
+ * below deletes them, so no seed is inserted (and
+ * 0 returned) if the edge list is short of room
+ */
+static size_t insertSeeds(Point **seeds, size_t num_seeds, Edge **seed_edges, EdgeList *edge_list)
+{
+    EdgeStack *crossings = calloc(num_seeds, sizeof *crossings);
+
+    #pragma omp taskloop grainsize(1)
+    for (size_t k = 0; k < num_seeds; k++)
+    {
+        collectCrossings(seeds[2 * k], seeds[2 * k + 1], crossings + k);
+        collectCrossings(seeds[2 * k + 1], seeds[2 * k], crossings + k);
+    }
+
+    size_t extra = num_seeds;
+    for (size_t k = 0; k < num_seeds; k++) extra += crossings[k].size;
+    if (4 * extra > edge_list->idx)
+    {
+        for (size_t k = 0; k < num_seeds; k++) free(crossings[k].data);
+        free(crossings);
+        return 0;
+    }
+
+    for (size_t k = 0; k < num_seeds; k++)
+    {
+        Point *l = seeds[2 * k];
+        Point *r = seeds[2 * k + 1];
+        for (size_t t = 0; t < crossings[k].size; t++)
+        {
+            Edge *h = (crossings[k].data)[t];
+            if (orientation(r, l, h->orig) > 0) h = h->twin;
+
+            // An edge can cross several seeds
+            if (h->oprev != NULL) detachEdge(h);
+        }
+        free(crossings[k].data);
+    }
+    free(crossings);
+
+    for (size_t k = 0; k < num_seeds; k++)
+    {
+        Point *l = seeds[2 * k];
+        Point *r = seeds[2 * k + 1];
+        seed_edges[k] = insertEdge(r, l, edge_list);
+
+        // Never moved by a stretch deleting edges
+        r->e = seed_edges[k];
+        l->e = seed_edges[k]->twin;
+    }
+
+    return num_seeds;
+}
+
+/* Add the crossing edges of a merge upwards from
+ * the lower common tangent base, an R-L edge.
+ * The first half holds the points less than split
+ * (compareXY, or compareYX for a vertical merge).
+ * Returns the upper common tangent
+ */
+Edge *zipSeam(Edge *base, ExtremeEdge *first_ex, ExtremeEdge *second_ex,
+              Point *split, int vertical, size_t num_points, EdgeList *edge_list)
+{
+    size_t num_bands = (size_t)teamSize();
+    if (num_points < SEAM_MIN_POINTS || num_bands == 1) return zipStretch(base, NULL, edge_list);
+
+    Cut cut;
+    cut.vertical = vertical;
+    cut.split = split;
+    cut.cut = across(vertical, split);
+
+    Point *low_first;
+    Point *low_second;
+    Point *high_first;
+    Point *high_second;
+    POWER across_min;
+    POWER across_max;
+    if (vertical)
+    {
+        cut.first_near = first_ex->top_edge_cw->orig;
+        cut.second_near = second_ex->bottom_edge_ccw->orig;
+        low_first = first_ex->right_edge_cw->orig;
+        low_second = second_ex->right_edge_cw->orig;
+        high_first = first_ex->left_edge_ccw->orig;
+        high_second = second_ex->left_edge_ccw->orig;
+        across_min = across(vertical, first_ex->bottom_edge_ccw->orig);
+        across_max = across(vertical, second_ex->top_edge_cw->orig);
+    }
+    else
+    {
+        cut.first_near = first_ex->right_edge_cw->orig;
+        cut.second_near = second_ex->left_edge_ccw->orig;
+        low_first = first_ex->bottom_edge_ccw->orig;
+        low_second = second_ex->bottom_edge_ccw->orig;
+        high_first = first_ex->top_edge_cw->orig;
+        high_second = second_ex->top_edge_cw->orig;
+        across_min = across(vertical, first_ex->left_edge_ccw->orig);
+        across_max = across(vertical, second_ex->right_edge_cw->orig);
+    }
+
+    POWER along_min = along(vertical, low_first);
+    if (along(vertical, low_second) < along_min) along_min = along(vertical, low_second);
+    POWER along_max = along(vertical, high_first);
+    if (along(vertical, high_second) > along_max) along_max = along(vertical, high_second);
+
+    if (along_max - along_min >= SEAM_MAX_SPAN || across_max - across_min >= SEAM_MAX_SPAN)
+    {
+        return zipStretch(base, NULL, edge_list);
+    }
+
+    Point **seeds = malloc(2 * num_bands * sizeof *seeds);
+    size_t num_seeds = findSeeds(&cut, base, along_min, along_max, num_bands, seeds);
+
+    Edge **stops = malloc((num_seeds + 1) * sizeof *stops);
+    num_seeds = insertSeeds(seeds, num_seeds, stops, edge_list); 
+    stops[num_seeds] = NULL;
+
+    // Stretch k runs from the seed below
+    // (or base) up to stops[k]
+    Edge **tops = malloc((num_seeds + 1) * sizeof *tops);
+    EdgeList shared;
+    borrowEdgeList(&shared, edge_list);
+
+    #pragma omp taskloop grainsize(1)
+    for (size_t k = 0; k <= num_seeds; k++)
+    {
+        Edge *from = k ? stops[k - 1] : base;
+        tops[k] = zipStretch(from, stops[k], &shared);
+    }
+
+    Edge *uct = tops[num_seeds];
+
+    free(tops);
+    free(stops);
+    free(seeds);
+
+    return uct;
+}
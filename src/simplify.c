@@ -0,0 +1,618 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "simplify.h"
+#include "trimesh.h"
+#include "hull.h"
+#include "topology.h"
+#include "helper.h"
+
+/* Terrain simplification by greedy insertion
+ * (Garland and Heckbert).
+ *
+ * Points carry heights. The triangulation starts as
+ * that of the convex hull, and every other point is
+ * a sample of the triangle it lies in. Each triangle
+ * knows its sample farthest (in height) from its own
+ * plane, and triangles sit in a priority queue by
+ * that error. The worst sample overall is inserted,
+ * splitting its triangle (or the two on the edge it
+ * lies on), and the new triangles are made Delaunay
+ * by Lawson flips of the edges opposite it, as in
+ * trimesh.c. The samples of every triangle changed
+ * lie in the star of the new point afterwards, so
+ * only they are located again (by walking from the
+ * new point) and only those triangles rescanned.
+ * This stops once no sample is farther than the
+ * tolerance from the surface.
+ *
+ * Each sample is rescanned when a point is inserted
+ * near it, which happens O(log N) times on average,
+ * so the whole costs close to O(N log N). Samples
+ * are copied out with their heights, in rows, so
+ * that those of a triangle are close in memory
+ */
+
+#define NEXT(i) (((i) + 1) % 3)
+#define PREV(i) (((i) + 2) % 3)
+
+typedef struct
+{
+    Point point;
+    double height;
+    int next;   // next sample in the same triangle
+    int idx;    // index of the point
+} Sample;
+
+typedef struct
+{
+    Point *points;
+    const double *heights;
+    TriangleList *triangle_list;
+
+    // Per triangle: its samples as a list through
+    // Sample.next, the worst of them (or -1) and its
+    // error, and its place in the queue (or -1)
+    int *first_sample;
+    int *worst;
+    double *error;
+    int *place;
+    char *touched;
+
+    Sample *samples;
+
+    int *queue;
+    size_t queue_size;
+
+    // Triangles changed by the last insertion,
+    // and the samples they held
+    int *changed;
+    size_t num_changed;
+    int *pool;
+    size_t pool_size;
+    int *stack;
+} Mesh;
+
+/***********************************
+ * QUEUE ***************************
+ ***********************************/
+
+static int worse(const Mesh *m, int t, int u)
+{
+    return m->error[t] > m->error[u] || (m->error[t] == m->error[u] && t < u);
+}
+
+static void placeAt(Mesh *m, size_t i, int t)
+{
+    m->queue[i] = t;
+    m->place[t] = (int)i;
+}
+
+static void siftUp(Mesh *m, size_t i)
+{
+    int t = m->queue[i];
+    while (i > 0 && worse(m, t, m->queue[(i - 1) / 2]))
+    {
+        placeAt(m, i, m->queue[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    placeAt(m, i, t);
+}
+
+static void siftDown(Mesh *m, size_t i)
+{
+    int t = m->queue[i];
+    while (1)
+    {
+        size_t c = 2 * i + 1;
+        if (c >= m->queue_size) break;
+        if (c + 1 < m->queue_size && worse(m, m->queue[c + 1], m->queue[c])) c++;
+        if (!worse(m, m->queue[c], t)) break;
+        placeAt(m, i, m->queue[c]);
+        i = c;
+    }
+    placeAt(m, i, t);
+}
+
+/* Put t in the queue at its error, or take it
+ * out if it has no samples
+ */
+static void requeue(Mesh *m, int t)
+{
+    int i = m->place[t];
+    if (m->worst[t] < 0)
+    {
+        if (i < 0) return;
+        m->place[t] = -1;
+        if ((size_t)i == --(m->queue_size)) return;
+
+        int last = m->queue[m->queue_size];
+        placeAt(m, (size_t)i, last);
+        siftUp(m, (size_t)i);
+        siftDown(m, (size_t)(m->place[last]));
+        return;
+    }
+
+    if (i < 0)
+    {
+        i = (int)(m->queue_size)++;
+        placeAt(m, (size_t)i, t);
+    }
+    siftUp(m, (size_t)i);
+    siftDown(m, (size_t)(m->place[t]));
+}
+
+/***********************************
+ * SAMPLES *************************
+ ***********************************/
+
+/* Find the worst sample of t against the
+ * plane through its corners
+ */
+static void rescan(Mesh *m, int t)
+{
+    Triangle *tri = m->triangle_list->triangles + t;
+    Point *a = m->points + tri->v[0];
+    Point *b = m->points + tri->v[1];
+    Point *c = m->points + tri->v[2];
+    double za = m->heights[tri->v[0]];
+
+    // Gradient of the plane, from its corners
+    double ux = (double)b->x - a->x, uy = (double)b->y - a->y;
+    double vx = (double)c->x - a->x, vy = (double)c->y - a->y;
+    double zu = m->heights[tri->v[1]] - za;
+    double zv = m->heights[tri->v[2]] - za;
+    double det = ux * vy - uy * vx;
+    double gx = (zu * vy - zv * uy) / det;
+    double gy = (zv * ux - zu * vx) / det;
+
+    m->worst[t] = -1;
+    m->error[t] = 0;
+    for (int s = m->first_sample[t]; s >= 0; s = m->samples[s].next)
+    {
+        Point *p = &m->samples[s].point;
+        double plane = za + gx * ((double)p->x - a->x) + gy * ((double)p->y - a->y);
+        double error = fabs(m->samples[s].height - plane);
+        if (m->worst[t] < 0 || error > m->error[t])
+        {
+            m->worst[t] = s;
+            m->error[t] = error;
+        }
+    }
+
+    requeue(m, t);
+}
+
+/* Walk from triangle t to the one holding p,
+ * always crossing an edge that p is beyond
+ */
+static int locate(const Mesh *m, int t, Point *p)
+{
+    Triangle *triangles = m->triangle_list->triangles;
+    while (1)
+    {
+        int i = 0;
+        while (i < 3 && orientation(m->points + triangles[t].v[NEXT(i)], m->points + triangles[t].v[PREV(i)], p) >= 0) i++;
+        if (i == 3) return t;
+
+        t = triangles[t].n[i];
+        if (t < 0)
+        {
+            printf("Something has gone very wrong.\nSample outside the hull.\nExiting...\n");
+            exit(1);
+        }
+    }
+}
+
+static void addSample(Mesh *m, int t, int s)
+{
+    m->samples[s].next = m->first_sample[t];
+    m->first_sample[t] = s;
+}
+
+/* Note t as changed, moving its samples to the pool
+ */
+static void change(Mesh *m, int t)
+{
+    if (m->touched[t]) return;
+    m->touched[t] = 1;
+    m->changed[(m->num_changed)++] = t;
+
+    for (int s = m->first_sample[t]; s >= 0; s = m->samples[s].next) m->pool[(m->pool_size)++] = s;
+    m->first_sample[t] = -1;
+}
+
+/* Hand the pooled samples (but inserted, the one
+ * just inserted) to the triangles now holding them,
+ * and rescan those
+ */
+static void redistribute(Mesh *m, int inserted)
+{
+    int t = m->changed[0];
+    for (size_t k = 0; k < m->pool_size; k++)
+    {
+        int s = m->pool[k];
+        if (s == inserted) continue;
+
+        // A sample on the edge of the changed region
+        // may land just outside it
+        t = locate(m, t, &m->samples[s].point);
+        if (!m->touched[t])
+        {
+            m->touched[t] = 1;
+            m->changed[(m->num_changed)++] = t;
+        }
+        addSample(m, t, s);
+    }
+
+    for (size_t k = 0; k < m->num_changed; k++)
+    {
+        rescan(m, m->changed[k]);
+        m->touched[m->changed[k]] = 0;
+    }
+    m->num_changed = 0;
+    m->pool_size = 0;
+}
+
+/***********************************
+ * INSERTION ***********************
+ ***********************************/
+
+static int newTriangle(Mesh *m, int a, int b, int c)
+{
+    int t = makeTriangle(a, b, c, m->triangle_list);
+    m->first_sample[t] = m->worst[t] = m->place[t] = -1;
+    m->touched[t] = 0;
+    change(m, t);
+    return t;
+}
+
+static void setTriangle(Triangle *t, int a, int b, int c, int na, int nb, int nc)
+{
+    t->v[0] = a;
+    t->v[1] = b;
+    t->v[2] = c;
+    t->n[0] = na;
+    t->n[1] = nb;
+    t->n[2] = nc;
+}
+
+/* Flip edges opposite p (v[0] of every triangle
+ * on the stack) until all are locally Delaunay
+ */
+static void legalize(Mesh *m, size_t top)
+{
+    Triangle *triangles = m->triangle_list->triangles;
+    int *stack = m->stack;
+    while (top)
+    {
+        int t = stack[--top];
+        int u = triangles[t].n[0];
+        if (u < 0) continue;
+
+        int p = triangles[t].v[0];
+        int a = triangles[t].v[1];
+        int b = triangles[t].v[2];
+
+        int j = 0;
+        while (triangles[u].n[j] != t) j++;
+        int q = triangles[u].v[j];
+
+        if (inCircle(m->points + p, m->points + a, m->points + b, m->points + q) <= 0) continue;
+        change(m, u);
+
+        // (p, a, b) + (q, b, a) becomes (p, a, q) + (p, q, b)
+        int n_aq = triangles[u].n[NEXT(j)];
+        int n_qb = triangles[u].n[PREV(j)];
+        int n_bp = triangles[t].n[1];
+        int n_pa = triangles[t].n[2];
+        setTriangle(triangles + t, p, a, q, n_aq, u, n_pa);
+        setTriangle(triangles + u, p, q, b, n_qb, n_bp, t);
+        replaceNeighbour(triangles, n_aq, u, t);
+        replaceNeighbour(triangles, n_bp, t, u);
+
+        stack[top++] = t;
+        stack[top++] = u;
+    }
+}
+
+/* Insert sample p into triangle t, which holds it,
+ * splitting t in three, or t and the triangle
+ * beyond in two each if p is on an edge
+ */
+static void insertPoint(Mesh *m, int t, int p)
+{
+    Triangle *triangles = m->triangle_list->triangles;
+    Point *pp = m->points + p;
+    change(m, t);
+
+    int i = 0;
+    while (i < 3 && orientation(m->points + triangles[t].v[NEXT(i)], m->points + triangles[t].v[PREV(i)], pp) != 0) i++;
+
+    int *stack = m->stack;
+    size_t top = 0;
+    if (i == 3)
+    {
+        int a = triangles[t].v[0], b = triangles[t].v[1], c = triangles[t].v[2];
+        int na = triangles[t].n[0], nb = triangles[t].n[1], nc = triangles[t].n[2];
+
+        int t1 = newTriangle(m, p, b, c);
+        int t2 = newTriangle(m, p, c, a);
+        setTriangle(triangles + t, p, a, b, nc, t1, t2);
+        setTriangle(triangles + t1, p, b, c, na, t2, t);
+        setTriangle(triangles + t2, p, c, a, nb, t, t1);
+        replaceNeighbour(triangles, na, t, t1);
+        replaceNeighbour(triangles, nb, t, t2);
+
+        stack[top++] = t;
+        stack[top++] = t1;
+        stack[top++] = t2;
+    }
+    else
+    {
+        // p is on a -> b, opposite c
+        int c = triangles[t].v[i], a = triangles[t].v[NEXT(i)], b = triangles[t].v[PREV(i)];
+        int na = triangles[t].n[NEXT(i)], nb = triangles[t].n[PREV(i)];
+        int u = triangles[t].n[i];
+
+        int t2 = newTriangle(m, p, c, a);
+        int u2 = -1;
+        if (u >= 0)
+        {
+            change(m, u);
+            int j = 0;
+            while (triangles[u].n[j] != t) j++;
+            int d = triangles[u].v[j];
+            int ua = triangles[u].n[PREV(j)], ub = triangles[u].n[NEXT(j)];
+
+            u2 = newTriangle(m, p, d, b);
+            setTriangle(triangles + u, p, a, d, ub, u2, t2);
+            setTriangle(triangles + u2, p, d, b, ua, t, u);
+            replaceNeighbour(triangles, ua, u, u2);
+
+            stack[top++] = u;
+            stack[top++] = u2;
+        }
+        setTriangle(triangles + t, p, b, c, na, t2, u2);
+        setTriangle(triangles + t2, p, c, a, nb, u, t);
+        replaceNeighbour(triangles, nb, t, t2);
+
+        stack[top++] = t;
+        stack[top++] = t2;
+    }
+
+    legalize(m, top);
+}
+
+/***********************************
+ * SIMPLIFICATION ******************
+ ***********************************/
+
+// By y, then x
+static int compareRows(const void *a, const void *b)
+{
+    const Point *p = &((const Sample *)a)->point;
+    const Point *q = &((const Sample *)b)->point;
+    if (p->y != q->y) return (p->y > q->y) - (p->y < q->y);
+    return (p->x > q->x) - (p->x < q->x);
+}
+
+/* Points in line, by greedy insertion in one
+ * dimension: heights are interpolated linearly
+ * between the points kept, from the two ends.
+ * Inserting a point only changes the errors of
+ * its own interval, so splitting every interval
+ * at its worst point until within tolerance keeps
+ * the same points as taking the worst overall.
+ * Leaves the points kept in chain, in line order
+ */
+static void simplifyLine(Mesh *m, Point *point_ptr_list[], size_t num_points, double tolerance,
+                         int **chain, size_t *chain_size)
+{
+    if (num_points == 0) return;
+
+    Point **line = malloc(num_points * sizeof *line);
+    for (size_t t = 0; t < num_points; t++) line[t] = point_ptr_list[t];
+    quicksort(line, 0, num_points - 1, compareXY);
+
+    // Position along the line, on its longer axis
+    Point *first = line[0];
+    Point *last = line[num_points - 1];
+    double dx = fabs((double)last->x - (double)first->x);
+    double dy = fabs((double)last->y - (double)first->y);
+    double *position = malloc(num_points * sizeof *position);
+    for (size_t t = 0; t < num_points; t++)
+    {
+        position[t] = dx >= dy ? (double)line[t]->x - (double)first->x : (double)line[t]->y - (double)first->y;
+    }
+
+    char *kept = calloc(num_points, sizeof *kept);
+    kept[0] = kept[num_points - 1] = 1;
+
+    // Intervals still to refine, as pairs of kept ends
+    size_t *stack = malloc(2 * num_points * sizeof *stack);
+    size_t top = 0;
+    if (num_points > 2)
+    {
+        stack[top++] = 0;
+        stack[top++] = num_points - 1;
+    }
+    while (top > 0)
+    {
+        size_t b = stack[--top];
+        size_t a = stack[--top];
+        double h_a = m->heights[line[a] - m->points];
+        double h_b = m->heights[line[b] - m->points];
+        double slope = (h_b - h_a) / (position[b] - position[a]);
+
+        size_t worst = a;
+        double error = tolerance;
+        for (size_t t = a + 1; t < b; t++)
+        {
+            double h = h_a + slope * (position[t] - position[a]);
+            double e = fabs(m->heights[line[t] - m->points] - h);
+            if (e > error)
+            {
+                worst = t;
+                error = e;
+            }
+        }
+        if (worst == a) continue;
+
+        kept[worst] = 1;
+        if (worst - a > 1)
+        {
+            stack[top++] = a;
+            stack[top++] = worst;
+        }
+        if (b - worst > 1)
+        {
+            stack[top++] = worst;
+            stack[top++] = b;
+        }
+    }
+
+    *chain = malloc(num_points * sizeof **chain);
+    *chain_size = 0;
+    for (size_t t = 0; t < num_points; t++)
+    {
+        if (kept[t]) (*chain)[(*chain_size)++] = (int)(line[t] - m->points);
+    }
+
+    free(stack);
+    free(kept);
+    free(position);
+    free(line);
+}
+
+/* Triangulate the hull and make every other
+ * point a sample. Returns 0 if the points are
+ * in line
+ */
+static int startMesh(Mesh *m, Point *point_ptr_list[], size_t num_points, size_t num_all)
+{
+    Point **hull = malloc(num_points * sizeof *hull);
+    for (size_t t = 0; t < num_points; t++) hull[t] = point_ptr_list[t];
+    size_t hull_size = convexHull(hull, num_points);
+
+    if (hull_size < 3)
+    {
+        free(hull);
+        return 0;
+    }
+
+    // The Delaunay triangulation of the hull vertices,
+    // from the triangle backend, copied in order
+    Point *corners = malloc(hull_size * sizeof *corners);
+    for (size_t t = 0; t < hull_size; t++) corners[t] = *(hull[t]);
+
+    int *line;
+    size_t line_size;
+    TriangleList *start = triangulateTriangles(corners, hull_size, &line, &line_size);
+    for (size_t k = 0; k < start->idx; k++)
+    {
+        Triangle *s = start->triangles + k;
+        int t = newTriangle(m, (int)(hull[s->v[0]] - m->points), (int)(hull[s->v[1]] - m->points),
+                            (int)(hull[s->v[2]] - m->points));
+        for (int i = 0; i < 3; i++) (m->triangle_list->triangles)[t].n[i] = s->n[i];
+    }
+    freeTriangles(start);
+    free(start);
+    free(corners);
+    free(line);
+
+    // Hull vertices are no samples
+    char *on_hull = calloc(num_all, sizeof *on_hull);
+    for (size_t t = 0; t < hull_size; t++) on_hull[hull[t] - m->points] = 1;
+
+    size_t num_samples = 0;
+    for (size_t t = 0; t < num_points; t++)
+    {
+        int idx = (int)(point_ptr_list[t] - m->points);
+        if (on_hull[idx]) continue;
+
+        Sample *s = m->samples + num_samples++;
+        s->point = m->points[idx];
+        s->height = m->heights[idx];
+        s->idx = idx;
+    }
+    qsort(m->samples, num_samples, sizeof *(m->samples), compareRows);
+    free(on_hull);
+    free(hull);
+
+    for (size_t s = 0; s < num_samples; s++) m->pool[(m->pool_size)++] = (int)s;
+    redistribute(m, -1);
+    return 1;
+}
+
+/* Triangulate a subset of the distinct points of
+ * point_ptr_list, from the hull up, until every
+ * height is within tolerance of the surface.
+ * Returns the triangles (indices into points), and
+ * the number of points used. Points all in line
+ * give no triangles, and those kept in chain
+ */
+TriangleList *simplifyTerrain(Point *points, const double *heights, Point *point_ptr_list[], size_t num_points,
+                              double tolerance, int **chain, size_t *chain_size, size_t *num_kept)
+{
+    size_t num_all = 0;
+    for (size_t t = 0; t < num_points; t++)
+    {
+        size_t idx = (size_t)(point_ptr_list[t] - points) + 1;
+        if (idx > num_all) num_all = idx;
+    }
+
+    Mesh m;
+    m.points = points;
+    m.heights = heights;
+    m.triangle_list = initializeTriangleList(num_points);
+
+    size_t capacity = m.triangle_list->size;
+    m.first_sample = malloc(capacity * sizeof *(m.first_sample));
+    m.worst = malloc(capacity * sizeof *(m.worst));
+    m.error = malloc(capacity * sizeof *(m.error));
+    m.place = malloc(capacity * sizeof *(m.place));
+    m.touched = malloc(capacity * sizeof *(m.touched));
+    m.queue = malloc(capacity * sizeof *(m.queue));
+    m.changed = malloc(capacity * sizeof *(m.changed));
+    m.stack = malloc(capacity * sizeof *(m.stack));
+    m.samples = malloc(num_points * sizeof *(m.samples));
+    m.pool = malloc(num_points * sizeof *(m.pool));
+    m.queue_size = m.num_changed = m.pool_size = 0;
+
+    *chain = NULL;
+    *chain_size = 0;
+    *num_kept = num_points;
+    if (num_points > 0 && startMesh(&m, point_ptr_list, num_points, num_all))
+    {
+        *num_kept = m.triangle_list->idx + 2;
+
+        // Worst sample first, until within tolerance
+        while (m.queue_size > 0 && m.error[m.queue[0]] > tolerance)
+        {
+            int t = m.queue[0];
+            int s = m.worst[t];
+            insertPoint(&m, t, m.samples[s].idx);
+            redistribute(&m, s);
+            (*num_kept)++;
+        }
+    }
+    else
+    {
+        simplifyLine(&m, point_ptr_list, num_points, tolerance, chain, chain_size);
+        *num_kept = *chain_size;
+    }
+
+    free(m.first_sample);
+    free(m.worst);
+    free(m.error);
+    free(m.place);
+    free(m.touched);
+    free(m.queue);
+    free(m.changed);
+    free(m.stack);
+    free(m.samples);
+    free(m.pool);
+
+    return m.triangle_list;
+}
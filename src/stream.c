@@ -0,0 +1,216 @@
+#include <math.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "stream.h"
+#include "topology.h"
+#include "helper.h"
+#include "queue.h"
+#include "io.h"
+
+/* Streaming edges out during the triangulation.
+ *
+ * A triangle is in the final triangulation once its
+ * circumcircle holds no other point of the input.
+ * When a block of points is triangulated, every
+ * triangle whose circle lies strictly inside the
+ * block's cell (the cuts of the calls above it) can
+ * only have points of the block in that circle, so
+ * it is final, and no later merge will delete its
+ * edges. These are formatted at once and handed to
+ * a writer thread; the rest, mostly near the cuts,
+ * are written by closeStream at the end.
+ *
+ * Edges are never freed once final, so a flag per
+ * slot of the edge list marks those written
+ */
+
+// Text is written in blocks of this size, with at
+// most WRITE_QUEUE_BLOCKS waiting for the writer
+#define WRITE_BLOCK_SIZE (1 << 16)
+#define WRITE_QUEUE_BLOCKS 32
+
+// Centres and radii are accurate to a few units in
+// the last place of long double, well inside this
+#define CIRCLE_SLACK 1e-12L
+
+// Circles are only tested while the 128-bit
+// numerators below cannot overflow
+#define CIRCLE_MAX_SPAN ((POWER)1 << 30)
+
+struct Stream
+{
+    PointList *point_list;
+    Edge *edges;
+    char *written;
+    FILE *out;
+    Queue *queue;
+    thrd_t writer;
+};
+
+static int writeBlocks(void *arg)
+{
+    Stream *stream = arg;
+    Block block;
+    while (popBlock(stream->queue, &block))
+    {
+        fwrite(block.data, 1, block.size, stream->out);
+        free(block.data);
+    }
+    return 0;
+}
+
+Stream *openStream(PointList *point_list, EdgeList *edge_list, FILE *out)
+{
+    Stream *stream = malloc(sizeof *stream);
+    stream->point_list = point_list;
+    stream->edges = edge_list->edges;
+    stream->written = calloc(edge_list->size, sizeof *(stream->written));
+    stream->out = out;
+    stream->queue = initializeQueue(WRITE_QUEUE_BLOCKS);
+
+    if (thrd_create(&stream->writer, writeBlocks, stream) != thrd_success)
+    {
+        printf("Failed to start writer thread\nExiting...\n");
+        exit(1);
+    }
+
+    return stream;
+}
+
+/***********************************
+ * OUTPUT **************************
+ ***********************************/
+
+static Block newBlock(void)
+{
+    Block block = {malloc(WRITE_BLOCK_SIZE), 0};
+    return block;
+}
+
+/* Same line as showEdges, endpoints in (x, y) order
+ */
+static void writeEdge(Stream *stream, Block *block, Edge *e)
+{
+    char *written = stream->written;
+    if (written[e - stream->edges]) return;
+    written[e - stream->edges] = 1;
+    written[e->twin - stream->edges] = 1;
+
+    if (!compareXY(e->orig, e->twin->orig)) e = e->twin;
+
+    if (block->size + EDGE_TEXT_MAX > WRITE_BLOCK_SIZE)
+    {
+        pushBlock(stream->queue, *block);
+        *block = newBlock();
+    }
+
+    block->size += formatEdge(block->data + block->size, stream->point_list, e);
+}
+
+static void sendBlock(Stream *stream, Block block)
+{
+    if (block.size > 0) pushBlock(stream->queue, block);
+    else free(block.data);
+}
+
+/***********************************
+ * FINAL TRIANGLES *****************
+ ***********************************/
+
+/* Whether the circle through a, b, c lies strictly
+ * inside cell. The centre is a + (nx, ny) / d with
+ * exact integer nx, ny and d, so only the last few
+ * steps are rounded
+ */
+static int circleInside(Point *a, Point *b, Point *c, const Cell *cell)
+{
+    POWER bx = (POWER)b->x - a->x;
+    POWER by = (POWER)b->y - a->y;
+    POWER qx = (POWER)c->x - a->x;
+    POWER qy = (POWER)c->y - a->y;
+
+    POWER span = CIRCLE_MAX_SPAN;
+    if (bx <= -span || bx >= span || by <= -span || by >= span) return 0;
+    if (qx <= -span || qx >= span || qy <= -span || qy >= span) return 0;
+
+    POWER d = 2 * (bx * qy - by * qx);
+    if (d == 0) return 0;
+
+    POWER b2 = bx * bx + by * by;
+    POWER q2 = qx * qx + qy * qy;
+    long double nx = (long double)(qy * b2 - by * q2);
+    long double ny = (long double)(bx * q2 - qx * b2);
+    long double dd = (long double)d;
+
+    long double x = a->x + nx / dd;
+    long double y = a->y + ny / dd;
+    long double r = hypotl(nx, ny) / fabsl(dd);
+    long double slack = CIRCLE_SLACK * (fabsl(x) + fabsl(y) + r + 1);
+
+    return x - r > cell->x_lo + slack && x + r < cell->x_hi - slack &&
+           y - r > cell->y_lo + slack && y + r < cell->y_hi - slack;
+}
+
+/* Write the edges of the final triangles of a
+ * block that has just been triangulated. Each
+ * triangle is visited from its first vertex
+ */
+void streamBlock(Stream *stream, Point *point_list[], size_t num_points, const Cell *cell)
+{
+    Block block = newBlock();
+
+    for (size_t idx = 0; idx < num_points; idx++)
+    {
+        Point *p = point_list[idx];
+        Edge *e = p->e;
+        Edge *f = e;
+
+        if (f == NULL) continue;
+
+        do {
+            Edge *g = f->dnext;
+            Edge *h = g->dnext;
+            if (g->orig > p && h->orig > p && isTriangle(f) && circleInside(p, g->orig, h->orig, cell))
+            {
+                writeEdge(stream, &block, f);
+                writeEdge(stream, &block, g);
+                writeEdge(stream, &block, h);
+            }
+            f = f->twin->dnext;
+        } while (f != e);
+    }
+
+    sendBlock(stream, block);
+}
+
+/* Write the edges not streamed yet and wait
+ * for the writer to finish
+ */
+void closeStream(Stream *stream)
+{
+    Block block = newBlock();
+
+    PointList *point_list = stream->point_list;
+    for (size_t idx = 0; idx < point_list->size; idx++)
+    {
+        Edge *e = (point_list->points)[idx].e;
+        Edge *f = e;
+
+        if (f == NULL) continue;
+
+        do {
+            writeEdge(stream, &block, f);
+            f = f->twin->dnext;
+        } while (f != e);
+    }
+
+    sendBlock(stream, block);
+
+    closeQueue(stream->queue);
+    thrd_join(stream->writer, NULL);
+    fflush(stream->out);
+
+    freeQueue(stream->queue);
+    free(stream->written);
+    free(stream);
+}
@@ -1,12 +1,46 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
 #include "topology.h"
+#include "helper.h"
 #include "io.h"
 
 /***********************************
  * POINTS **************************
  ***********************************/
 
+/* Allocate a point list with room for
+ * capacity points, all of them unused
+ */
+PointList *initializePointList(size_t capacity)
+{
+    PointList *point_list = malloc(sizeof *point_list);
+
+    point_list->points = malloc(capacity * sizeof *(point_list->points));
+    point_list->unused_points = malloc(capacity * sizeof *(point_list->unused_points));
+    point_list->original = NULL;
+    resetPointList(point_list, capacity);
+
+    return point_list;
+}
+
+/* Mark the first capacity points of a list
+ * allocated for at least that many as unused,
+ * so its memory can be used for a new point set
+ */
+void resetPointList(PointList *point_list, size_t capacity)
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        (point_list->points)[i].e = NULL;
+        (point_list->unused_points)[i] = point_list->points + capacity - 1 - i;
+    }
+
+    point_list->idx = capacity;
+    point_list->size = capacity;
+}
+
 Point *getPoint(PointList *point_list)
 {
     if (point_list->idx == 0)
@@ -56,8 +90,28 @@ void freePoints(PointList *point_list)
  * EDGES ***************************
  ***********************************/
 
+/* Start a list that shares the stack of parent,
+ * so several threads can take and free edges at once
+ */
+void borrowEdgeList(EdgeList *edge_list, EdgeList *parent)
+{
+    edge_list->edges = parent->edges;
+    edge_list->unused_edges = NULL;
+    edge_list->idx = edge_list->size = 0;
+    edge_list->parent = parent;
+    edge_list->fixed = parent->fixed;
+}
+
 Edge *getEdge(EdgeList *edge_list)
 {
+    if (edge_list->parent)
+    {
+        Edge *e;
+        #pragma omp critical(shared_edges)
+        e = getEdge(edge_list->parent);
+        return e;
+    }
+
     if (edge_list->idx == 0)
     {
         printf("Out of edge memory (%zu edges)\nExiting...\n", edge_list->size);
@@ -74,6 +128,13 @@ Edge *getEdge(EdgeList *edge_list)
  */
 void freeEdge(EdgeList *edge_list, Edge *e)
 {
+    if (edge_list->parent)
+    {
+        #pragma omp critical(shared_edges)
+        freeEdge(edge_list->parent, e);
+        return;
+    }
+
     (edge_list->unused_edges)[edge_list->idx] = e;
     (edge_list->idx)++;
 }
@@ -82,6 +143,23 @@ void freeEdges(EdgeList *edge_list)
 {
     free(edge_list->edges);
     free(edge_list->unused_edges);
+    free(edge_list->fixed);
+}
+
+/* Flag the edge e (both halves) as a constraint,
+ * which merges never delete
+ */
+void fixEdge(Edge *e, EdgeList *edge_list)
+{
+    if (edge_list->fixed == NULL) edge_list->fixed = calloc(edge_list->size, sizeof *(edge_list->fixed));
+
+    (edge_list->fixed)[e - edge_list->edges] = 1;
+    (edge_list->fixed)[e->twin - edge_list->edges] = 1;
+}
+
+int isFixed(Edge *e, EdgeList *edge_list)
+{
+    return edge_list->fixed && (edge_list->fixed)[e - edge_list->edges];
 }
 
 /* Allocate and initialize edge from
@@ -95,6 +173,13 @@ Edge *makeEdge(Point *orig, Point *dest, EdgeList *edge_list)
     Edge *e = getEdge(edge_list);
     Edge *et = getEdge(edge_list);
 
+    // Slots are reused, flags are not
+    if (edge_list->fixed)
+    {
+        (edge_list->fixed)[e - edge_list->edges] = 0;
+        (edge_list->fixed)[et - edge_list->edges] = 0;
+    }
+
     // Initialize edge
     e->orig = orig;
     e->oprev = e->dnext = et;
@@ -122,6 +207,15 @@ void destroyEdge(Edge *e, EdgeList *edge_list)
     Point *orig = e->orig;
     Point *dest = et->orig;
 
+    // Already detached from dest, see detachEdge
+    if (e->dnext == NULL)
+    {
+        detachEdge(e);
+        freeEdge(edge_list, e);
+        freeEdge(edge_list, et);
+        return;
+    }
+
     // Update edge adj to orig/dest if necessary
     if (orig->e == e) orig->e = (et->dnext == e) ? NULL : et->dnext;
     if (dest->e == et) dest->e = (e->dnext == et) ? NULL : e->dnext;
@@ -136,6 +230,27 @@ void destroyEdge(Edge *e, EdgeList *edge_list)
     freeEdge(edge_list, et);
 }
 
+/* Remove e from the ring about its origin only,
+ * leaving the ring about its destination (and
+ * the memory) alone. The links of that ring are
+ * cleared, so destroyEdge on the twin later
+ * finishes the job from the other end.
+ * Lets two threads each own one end of an edge
+ */
+void detachEdge(Edge *e)
+{
+    Edge *et = e->twin;
+    Point *orig = e->orig;
+
+    if (orig->e == e) orig->e = (et->dnext == e) ? NULL : et->dnext;
+
+    e->oprev->dnext = et->dnext;
+    et->dnext->oprev = e->oprev;
+
+    e->oprev = NULL;
+    et->dnext = NULL;
+}
+
 /**********************************
  * BUILDING ***********************
  **********************************/
@@ -184,6 +299,56 @@ Edge *bridge(Edge *in, Edge *out, EdgeList *edge_list)
     return e;
 }
 
+/* Find the edge out of a which immediately
+ * follows direction a -> b when rotating
+ * counter-clockwise about a, that is,
+ * the edge that should become dnext of
+ * a new edge from b to a.
+ * Returns NULL if a has no edges
+ */
+Edge *ringSuccessor(Point *a, Point *b)
+{
+    Edge *f = a->e;
+    if (f == NULL) return NULL;
+
+    Edge *g = f->twin->dnext;
+    if (g == f) return f;
+
+    Edge *start = f;
+    do
+    {
+        Point *u = f->twin->orig;
+        Point *w = g->twin->orig;
+
+        // b strictly inside the wedge from u counter-clockwise to w
+        int inside;
+        if (orientation(a, u, w) > 0) inside = (orientation(a, u, b) > 0) && (orientation(a, b, w) > 0);
+        else inside = (orientation(a, u, b) > 0) || (orientation(a, b, w) > 0);
+        if (inside) return g;
+
+        f = g;
+        g = g->twin->dnext;
+    } while (f != start);
+
+    return start;
+}
+
+/* Insert edge from a to b into the graph,
+ * placing it in the rings of a and b by angle.
+ * Assumes the edge crosses no existing edge
+ */
+Edge *insertEdge(Point *a, Point *b, EdgeList *edge_list)
+{
+    Edge *out_a = ringSuccessor(a, b);
+    Edge *out_b = ringSuccessor(b, a);
+
+    Edge *e = makeEdge(a, b, edge_list);
+    if (out_a) weld(e->twin, out_a);
+    if (out_b) weld(e, out_b);
+
+    return e;
+}
+
 /*********************************
  * MISC **************************
  *********************************/
@@ -211,36 +376,261 @@ int onConvexHull(Point *p)
     return 0;
 }
 
+/* Faces lie to the right of their edges, so
+ * interior triangles are clockwise 3-cycles.
+ * Anything else belongs to the outer face
+ */
+int isTriangle(Edge *e)
+{
+    Edge *f = e->dnext;
+    Edge *g = f->dnext;
+    return (g->dnext == e) && (orientation(e->orig, f->orig, g->orig) < 0);
+}
+
 /* Positive if a, b, c counter-clockwise
  * Negative if a, b, c clockwise
  * Zero if a, b, c collinear
  */
-VALUE orientation(Point *a, Point *b, Point *c)
+int orientation(Point *a, Point *b, Point *c)
 {
-    VALUE d_11 = a->x - c->x;
-    VALUE d_21 = b->x - c->x;
-    VALUE d_12 = a->y - c->y;
-    VALUE d_22 = b->y - c->y;
+    AREA d_11 = (AREA)a->x - c->x;
+    AREA d_21 = (AREA)b->x - c->x;
+    AREA d_12 = (AREA)a->y - c->y;
+    AREA d_22 = (AREA)b->y - c->y;
+
+    AREA det = d_11 * d_22 - d_12 * d_21;
+    return (det > 0) - (det < 0);
+}
+
+/* Shewchuk's static incircle filter. The differences
+ * must be exact in double. Returns the sign of the
+ * determinant, or 0 if the error bound cannot tell
+ */
+static int circleFilter(double d_11, double d_12, double d_21, double d_22, double d_31, double d_32)
+{
+    double l_13 = d_11*d_11 + d_12*d_12;
+    double l_23 = d_21*d_21 + d_22*d_22;
+    double l_33 = d_31*d_31 + d_32*d_32;
+    double m_1 = d_22*d_31;
+    double m_2 = d_21*d_32;
+    double m_3 = d_21*d_12;
+    double m_4 = d_11*d_22;
+    double m_5 = d_11*d_32;
+    double m_6 = d_31*d_12;
+    double approx = l_13 * (m_2 - m_1) + l_23 * (m_6 - m_5) + l_33 * (m_4 - m_3);
+    double permanent = l_13 * (fabs(m_2) + fabs(m_1)) + l_23 * (fabs(m_6) + fabs(m_5)) + l_33 * (fabs(m_4) + fabs(m_3));
+    double bound = 1.1102230246251577e-15 * permanent;
+    if (approx > bound) return 1;
+    if (-approx > bound) return -1;
+    return 0;
+}
+
+#ifndef NARROW_COORDS
+/* Signed 320-bit integers, in two's complement over
+ * 64-bit limbs, least significant first. Arithmetic
+ * wraps modulo 2^320, so intermediate results may
+ * overflow as long as the final one fits: the
+ * incircle determinant of differences below 2^64
+ * is below 2^261
+ */
+#define BIG_LIMBS 5
+
+typedef struct
+{
+    uint64_t limb[BIG_LIMBS];
+} BigInt;
+
+__extension__ typedef unsigned __int128 Carry;
 
-    return d_11 * d_22 - d_12 * d_21;
+static BigInt bigFrom(AREA v)
+{
+    BigInt r;
+    uint64_t fill = v < 0 ? UINT64_MAX : 0;
+    r.limb[0] = (uint64_t)v;
+    r.limb[1] = (uint64_t)(v >> 64);
+    for (int i = 2; i < BIG_LIMBS; i++) r.limb[i] = fill;
+    return r;
+}
+
+static BigInt bigAdd(BigInt a, BigInt b)
+{
+    BigInt r;
+    Carry carry = 0;
+    for (int i = 0; i < BIG_LIMBS; i++)
+    {
+        carry += (Carry)a.limb[i] + b.limb[i];
+        r.limb[i] = (uint64_t)carry;
+        carry >>= 64;
+    }
+    return r;
+}
+
+static BigInt bigSub(BigInt a, BigInt b)
+{
+    // a + ~b + 1
+    BigInt r;
+    Carry carry = 1;
+    for (int i = 0; i < BIG_LIMBS; i++)
+    {
+        carry += (Carry)a.limb[i] + ~b.limb[i];
+        r.limb[i] = (uint64_t)carry;
+        carry >>= 64;
+    }
+    return r;
+}
+
+static BigInt bigMul(BigInt a, BigInt b)
+{
+    BigInt r = {{0}};
+    for (int i = 0; i < BIG_LIMBS; i++)
+    {
+        Carry carry = 0;
+        for (int j = 0; i + j < BIG_LIMBS; j++)
+        {
+            carry += (Carry)a.limb[i] * b.limb[j] + r.limb[i + j];
+            r.limb[i + j] = (uint64_t)carry;
+            carry >>= 64;
+        }
+    }
+    return r;
 }
 
+static int bigSign(BigInt a)
+{
+    if (a.limb[BIG_LIMBS - 1] >> 63) return -1;
+    for (int i = 0; i < BIG_LIMBS; i++)
+    {
+        if (a.limb[i]) return 1;
+    }
+    return 0;
+}
+
+/* circleSign for differences of 2^30 and more,
+ * where the 128-bit determinant overflows. The
+ * filter only applies while differences are exact
+ * in double, the rest is evaluated in 320 bits
+ */
+static int circleSignWide(AREA d_11, AREA d_12, AREA d_21, AREA d_22, AREA d_31, AREA d_32)
+{
+    AREA exact = (AREA)1 << 53;
+    if (d_11 > -exact && d_11 < exact && d_12 > -exact && d_12 < exact && d_21 > -exact && d_21 < exact &&
+        d_22 > -exact && d_22 < exact && d_31 > -exact && d_31 < exact && d_32 > -exact && d_32 < exact)
+    {
+        int sign = circleFilter((double)d_11, (double)d_12, (double)d_21, (double)d_22, (double)d_31, (double)d_32);
+        if (sign) return sign;
+    }
+
+    BigInt b_11 = bigFrom(d_11);
+    BigInt b_12 = bigFrom(d_12);
+    BigInt b_21 = bigFrom(d_21);
+    BigInt b_22 = bigFrom(d_22);
+    BigInt b_31 = bigFrom(d_31);
+    BigInt b_32 = bigFrom(d_32);
+
+    BigInt b_13 = bigAdd(bigMul(b_11, b_11), bigMul(b_12, b_12));
+    BigInt b_23 = bigAdd(bigMul(b_21, b_21), bigMul(b_22, b_22));
+    BigInt b_33 = bigAdd(bigMul(b_31, b_31), bigMul(b_32, b_32));
+
+    BigInt det = bigMul(b_11, bigSub(bigMul(b_22, b_33), bigMul(b_32, b_23)));
+    det = bigSub(det, bigMul(b_12, bigSub(bigMul(b_21, b_33), bigMul(b_31, b_23))));
+    det = bigAdd(det, bigMul(b_13, bigSub(bigMul(b_21, b_32), bigMul(b_31, b_22))));
+    return bigSign(det);
+}
+#endif
+
 /* Assumes a, b, c in counter-clockwise order.
  * Then positive if d in circle,
  *  negative if d outside circle,
  *  zero if d on circle
  */
-VALUE inCircle(Point *a, Point *b, Point *c, Point *d)
+static int circleSign(Point *a, Point *b, Point *c, Point *d)
+{
+    #ifndef NARROW_COORDS
+    // Differences this large overflow the 128-bit
+    // determinant, and may overflow a long themselves
+    AREA big = 2 * NARROW_COORD_LIMIT;
+    AREA w_11 = (AREA)a->x - d->x;
+    AREA w_12 = (AREA)a->y - d->y;
+    AREA w_21 = (AREA)b->x - d->x;
+    AREA w_22 = (AREA)b->y - d->y;
+    AREA w_31 = (AREA)c->x - d->x;
+    AREA w_32 = (AREA)c->y - d->y;
+    if (w_11 <= -big || w_11 >= big || w_12 <= -big || w_12 >= big || w_21 <= -big || w_21 >= big ||
+        w_22 <= -big || w_22 >= big || w_31 <= -big || w_31 >= big || w_32 <= -big || w_32 >= big)
+    {
+        return circleSignWide(w_11, w_12, w_21, w_22, w_31, w_32);
+    }
+    #endif
+
+    long d_11 = (long)a->x - d->x;
+    long d_12 = (long)a->y - d->y;
+    long d_21 = (long)b->x - d->x;
+    long d_22 = (long)b->y - d->y;
+    long d_31 = (long)c->x - d->x;
+    long d_32 = (long)c->y - d->y;
+
+    // Cheap floating-point evaluation first. The
+    // differences are exact in double
+    int sign = circleFilter((double)d_11, (double)d_12, (double)d_21, (double)d_22, (double)d_31, (double)d_32);
+    if (sign) return sign;
+
+    POWER d_13 = (POWER)d_11*d_11 + (POWER)d_12*d_12;
+    POWER d_23 = (POWER)d_21*d_21 + (POWER)d_22*d_22;
+    POWER d_33 = (POWER)d_31*d_31 + (POWER)d_32*d_32;
+
+    POWER det = d_11 * (d_22*d_33 - d_32*d_23) - d_12 * (d_21*d_33 - d_31*d_23) + d_13 * ((POWER)d_21*d_32 - (POWER)d_31*d_22);
+    return (det > 0) - (det < 0);
+}
+
+/* Break a tie of circleSign by symbolic perturbation.
+ * The sign is that of the determinant of the points
+ * lifted to (x, y, x^2 + y^2), with the lift of the
+ * k-th largest point (compareXY) raised by eps^k for
+ * a vanishing eps. The term of each lift is the
+ * orientation of the other three points, so the sign
+ * is that of the first of these, from the largest
+ * point down, that is not zero. Since the order only
+ * depends on the points, every caller (and both
+ * backends) sees the same perturbed point set, which
+ * has a unique Delaunay triangulation
+ */
+static int perturbedCircleSign(Point *a, Point *b, Point *c, Point *d)
+{
+    // The same point twice stays degenerate
+    if (d == a || d == b || d == c || a == b || b == c || c == a) return 0;
+
+    Point *p[4] = {a, b, c, d};
+    int term[4] = {orientation(b, c, d), -orientation(a, c, d), orientation(a, b, d), -orientation(a, b, c)};
+    int done[4] = {0, 0, 0, 0};
+
+    for (int k = 0; k < 4; k++)
+    {
+        int m = -1;
+        for (int i = 0; i < 4; i++)
+        {
+            if (!done[i] && (m < 0 || compareXY(p[m], p[i]))) m = i;
+        }
+        if (term[m] != 0) return term[m];
+        done[m] = 1;
+    }
+    return 0;
+}
+
+/* Assumes a, b, c in counter-clockwise order.
+ * Then positive if d in circle and negative if
+ * d outside circle. Ties of points on the circle
+ * are broken by perturbedCircleSign, so zero is
+ * only returned if all four points are collinear
+ */
+int inCircle(Point *a, Point *b, Point *c, Point *d)
 {
-    VALUE d_11 = a->x - d->x;
-    VALUE d_12 = a->y - d->y;
-    VALUE d_13 = d_11*d_11 + d_12*d_12;
-    VALUE d_21 = b->x - d->x;
-    VALUE d_22 = b->y - d->y;
-    VALUE d_23 = d_21*d_21 + d_22*d_22;
-    VALUE d_31 = c->x - d->x;
-    VALUE d_32 = c->y - d->y;
-    VALUE d_33 = d_31*d_31 + d_32*d_32;
+    int sign = circleSign(a, b, c, d);
+    return sign ? sign : perturbedCircleSign(a, b, c, d);
+}
 
-    return d_11 * (d_22*d_33 - d_32*d_23) - d_12 * (d_21*d_33 - d_31*d_23) + d_13 * (d_21*d_32 - d_31*d_22);
+/* Whether d is exactly on the circle through a, b, c
+ */
+int cocircular(Point *a, Point *b, Point *c, Point *d)
+{
+    return circleSign(a, b, c, d) == 0;
 }
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "trimesh.h"
+#include "topology.h"
+#include "helper.h"
+#include "io.h"
+
+/* Triangle-based backend.
+ *
+ * Points are swept outwards in order of distance from
+ * the centre of their bounding box, so every new point
+ * lies outside the current convex hull and is joined to
+ * the chain of hull edges it can see. New triangles are
+ * then made Delaunay by Lawson flips of the edges
+ * opposite the new point.
+ *
+ * The hull is kept as a circular doubly-linked list
+ * of point indices in counter-clockwise order, with
+ * hull_tri[v] the triangle on hull edge v -> next[v],
+ * and a hash on angle about the centre to find where
+ * a new point meets it.
+ */
+
+#define NEXT(i) (((i) + 1) % 3)
+#define PREV(i) (((i) + 2) % 3)
+
+TriangleList *initializeTriangleList(size_t num_points)
+{
+    TriangleList *triangle_list = malloc(sizeof *triangle_list);
+
+    // A triangulation of V points has < 2*V triangles
+    triangle_list->size = 2 * num_points;
+    triangle_list->triangles = malloc(triangle_list->size * sizeof *(triangle_list->triangles));
+    triangle_list->idx = 0;
+
+    return triangle_list;
+}
+
+void freeTriangles(TriangleList *triangle_list)
+{
+    free(triangle_list->triangles);
+}
+
+int makeTriangle(int a, int b, int c, TriangleList *triangle_list)
+{
+    if (triangle_list->idx == triangle_list->size)
+    {
+        printf("Out of triangle memory (%zu triangles)\nExiting...\n", triangle_list->size);
+        exit(1);
+    }
+
+    Triangle *t = triangle_list->triangles + triangle_list->idx;
+    t->v[0] = a;
+    t->v[1] = b;
+    t->v[2] = c;
+    t->n[0] = t->n[1] = t->n[2] = -1;
+
+    return (int)(triangle_list->idx)++;
+}
+
+/* In triangle t, point the neighbour
+ * reference old at new instead
+ */
+void replaceNeighbour(Triangle *triangles, int t, int old, int new)
+{
+    if (t < 0) return;
+    for (int i = 0; i < 3; i++)
+    {
+        if (triangles[t].n[i] == old)
+        {
+            triangles[t].n[i] = new;
+            return;
+        }
+    }
+}
+
+/* Flip edges opposite v[0] until every triangle on
+ * the stack is locally Delaunay. Triangles on the
+ * stack always have the new point as v[0]
+ */
+static void legalize(int *stack, size_t top, Point *points, TriangleList *triangle_list, int *hull_tri)
+{
+    Triangle *triangles = triangle_list->triangles;
+    while (top)
+    {
+        int t = stack[--top];
+        int u = triangles[t].n[0];
+        if (u < 0) continue;
+
+        int p = triangles[t].v[0];
+        int a = triangles[t].v[1];
+        int b = triangles[t].v[2];
+
+        int j = 0;
+        while (triangles[u].n[j] != t) j++;
+        int q = triangles[u].v[j];
+
+        if (inCircle(points + p, points + a, points + b, points + q) <= 0) continue;
+
+        // Flip a-b to p-q, so (p, a, b) + (q, b, a)
+        // becomes (p, a, q) + (p, q, b)
+        int n_aq = triangles[u].n[NEXT(j)];
+        int n_qb = triangles[u].n[PREV(j)];
+        int n_bp = triangles[t].n[1];
+        int n_pa = triangles[t].n[2];
+
+        triangles[t].v[2] = q;
+        triangles[t].n[0] = n_aq;
+        triangles[t].n[1] = u;
+        triangles[t].n[2] = n_pa;
+
+        triangles[u].v[0] = p;
+        triangles[u].v[1] = q;
+        triangles[u].v[2] = b;
+        triangles[u].n[0] = n_qb;
+        triangles[u].n[1] = n_bp;
+        triangles[u].n[2] = t;
+
+        replaceNeighbour(triangles, n_aq, u, t);
+        replaceNeighbour(triangles, n_bp, t, u);
+        if (n_aq < 0) hull_tri[a] = t;
+        if (n_bp < 0) hull_tri[b] = u;
+
+        stack[top++] = t;
+        stack[top++] = u;
+    }
+}
+
+typedef struct
+{
+    AREA distance;
+    VALUE x;
+    VALUE y;
+    int idx;
+} RadialKey;
+
+static int compareRadial(const void *a, const void *b)
+{
+    const RadialKey *p = a;
+    const RadialKey *q = b;
+    if (p->distance != q->distance) return (p->distance > q->distance) - (p->distance < q->distance);
+    if (p->x != q->x) return (p->x > q->x) - (p->x < q->x);
+    if (p->y != q->y) return (p->y > q->y) - (p->y < q->y);
+
+    // The first of a set of duplicates is kept
+    return (p->idx > q->idx) - (p->idx < q->idx);
+}
+
+/* Bucket for the angle of p about (cx, cy),
+ * using a pseudo-angle monotone in the true one
+ */
+static size_t angleBucket(Point *p, VALUE cx, VALUE cy, size_t hash_size)
+{
+    double dx = (double)p->x - cx;
+    double dy = (double)p->y - cy;
+    double l1 = (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+    if (l1 == 0) return 0;
+
+    double q = dx / l1;
+    double angle = (dy > 0 ? 3 - q : 1 + q) / 4;
+    return (size_t)(angle * hash_size) % hash_size;
+}
+
+/* Triangulate points[0 .. num_points - 1] into a new
+ * triangle list. Exact duplicates are skipped,
+ * keeping the first of each as the edge backend does.
+ * If every point is collinear there are no triangles,
+ * and the chain is reported through chain/chain_size
+ */
+TriangleList *triangulateTriangles(Point *points, size_t num_points, int **chain, size_t *chain_size)
+{
+    TriangleList *triangle_list = initializeTriangleList(num_points);
+    *chain = NULL;
+    *chain_size = 0;
+    if (num_points == 0) return triangle_list;
+
+    // Sort by exact distance from the centre of the bounding box.
+    // Every point is then outside the hull of all earlier ones
+    VALUE x_min = points[0].x, x_max = points[0].x;
+    VALUE y_min = points[0].y, y_max = points[0].y;
+    for (size_t t = 1; t < num_points; t++)
+    {
+        if (points[t].x < x_min) x_min = points[t].x;
+        if (points[t].x > x_max) x_max = points[t].x;
+        if (points[t].y < y_min) y_min = points[t].y;
+        if (points[t].y > y_max) y_max = points[t].y;
+    }
+    VALUE cx = x_min + (x_max - x_min) / 2;
+    VALUE cy = y_min + (y_max - y_min) / 2;
+
+    RadialKey *keys = malloc(num_points * sizeof *keys);
+    for (size_t t = 0; t < num_points; t++)
+    {
+        AREA dx = (AREA)points[t].x - cx;
+        AREA dy = (AREA)points[t].y - cy;
+        keys[t].distance = dx * dx + dy * dy;
+        keys[t].x = points[t].x;
+        keys[t].y = points[t].y;
+        keys[t].idx = (int)t;
+    }
+    qsort(keys, num_points, sizeof *keys, compareRadial);
+
+    // Work on a copy in sweep order for locality,
+    // remembering where each point came from
+    Point *pts = malloc(num_points * sizeof *pts);
+    int *original = malloc(num_points * sizeof *original);
+    size_t m = 0;
+    for (size_t t = 0; t < num_points; t++)
+    {
+        if (m > 0 && keys[t].x == pts[m - 1].x && keys[t].y == pts[m - 1].y) continue;
+        pts[m].x = keys[t].x;
+        pts[m].y = keys[t].y;
+        pts[m].e = NULL;
+        original[m] = keys[t].idx;
+        m++;
+    }
+    free(keys);
+
+    // Collinear prefix
+    size_t s = 1;
+    while (s < m && (s < 2 || orientation(pts, pts + 1, pts + s) == 0)) s++;
+
+    Point **line_ptrs = malloc(s * sizeof *line_ptrs);
+    for (size_t t = 0; t < s; t++) line_ptrs[t] = pts + t;
+    quicksort(line_ptrs, 0, s - 1, compareXY);
+    int *line = malloc(s * sizeof *line);
+    size_t num_line = s;
+    for (size_t t = 0; t < s; t++) line[t] = (int)(line_ptrs[t] - pts);
+    free(line_ptrs);
+
+    if (s == m)
+    {
+        for (size_t t = 0; t < num_line; t++) line[t] = original[line[t]];
+        free(pts);
+        free(original);
+        *chain = line;
+        *chain_size = num_line;
+        return triangle_list;
+    }
+
+    int *next = malloc(m * sizeof *next);
+    int *prev = malloc(m * sizeof *prev);
+    int *hull_tri = malloc(m * sizeof *hull_tri);
+    int *stack = malloc((2 * m + 2) * sizeof *stack);
+
+    size_t hash_size = 1;
+    while (hash_size * hash_size < m) hash_size++;
+    int *hash = malloc(hash_size * sizeof *hash);
+    for (size_t t = 0; t < hash_size; t++) hash[t] = -1;
+
+    // Fan the first off-line point over the line
+    Triangle *triangles = triangle_list->triangles;
+    int p = (int)s++;
+    int left = orientation(pts + line[0], pts + line[num_line - 1], pts + p) > 0;
+    int prev_t = -1;
+    for (size_t i = 0; i + 1 < num_line; i++)
+    {
+        int a = left ? line[i] : line[i + 1];
+        int b = left ? line[i + 1] : line[i];
+        int t = makeTriangle(p, a, b, triangle_list);
+
+        // Neighbours share the edge from p to line[i]
+        if (prev_t >= 0)
+        {
+            if (left) { triangles[t].n[2] = prev_t; triangles[prev_t].n[1] = t; }
+            else { triangles[t].n[1] = prev_t; triangles[prev_t].n[2] = t; }
+        }
+        prev_t = t;
+
+        next[a] = b;
+        prev[b] = a;
+        hull_tri[a] = t;
+    }
+    int first = left ? line[0] : line[num_line - 1];
+    int last = left ? line[num_line - 1] : line[0];
+    next[last] = p;
+    prev[p] = last;
+    next[p] = first;
+    prev[first] = p;
+    hull_tri[last] = left ? prev_t : 0;
+    hull_tri[p] = left ? 0 : prev_t;
+    for (size_t t = 0; t < num_line; t++) hash[angleBucket(pts + line[t], cx, cy, hash_size)] = line[t];
+    hash[angleBucket(pts + p, cx, cy, hash_size)] = p;
+    free(line);
+
+    // Sweep the remaining points
+    for (; s < m; s++)
+    {
+        p = (int)s;
+        Point *pp = pts + p;
+
+        // Start from a hull vertex at a similar angle
+        size_t key = angleBucket(pp, cx, cy, hash_size);
+        int start = -1;
+        for (size_t j = 0; j < hash_size && start < 0; j++)
+        {
+            start = hash[(key + j) % hash_size];
+            if (start >= 0 && next[start] < 0) start = -1;
+        }
+
+        // Buckets run counter-clockwise, so the edges p sees
+        // are just before start
+        start = prev[start];
+        int l = start;
+        while (orientation(pts + l, pts + next[l], pp) >= 0)
+        {
+            l = next[l];
+            if (l == start)
+            {
+                printf("Something has gone very wrong.\nNew point sees no hull edge.\nExiting...\n");
+                exit(1);
+            }
+        }
+        int r = next[l];
+        while (orientation(pts + prev[l], pts + l, pp) < 0) l = prev[l];
+        while (orientation(pts + r, pts + next[r], pp) < 0) r = next[r];
+
+        size_t top = 0;
+        prev_t = -1;
+        int a = l;
+        while (a != r)
+        {
+            int b = next[a];
+            int h = hull_tri[a];
+            int t = makeTriangle(p, b, a, triangle_list);
+            triangles[t].n[0] = h;
+            for (int i = 0; i < 3; i++)
+            {
+                if (triangles[h].v[i] != a && triangles[h].v[i] != b) triangles[h].n[i] = t;
+            }
+            if (prev_t >= 0)
+            {
+                triangles[t].n[1] = prev_t;
+                triangles[prev_t].n[2] = t;
+            }
+            else hull_tri[l] = t;
+            prev_t = t;
+            stack[top++] = t;
+
+            // Vertices strictly between l and r leave the hull
+            if (a != l) next[a] = -1;
+            a = b;
+        }
+        hull_tri[p] = prev_t;
+        next[l] = p;
+        prev[p] = l;
+        next[p] = r;
+        prev[r] = p;
+        hash[angleBucket(pp, cx, cy, hash_size)] = p;
+        hash[angleBucket(pts + l, cx, cy, hash_size)] = l;
+
+        legalize(stack, top, pts, triangle_list, hull_tri);
+    }
+
+    // Back to indices into points
+    for (size_t t = 0; t < triangle_list->idx; t++)
+    {
+        for (int i = 0; i < 3; i++) triangles[t].v[i] = original[triangles[t].v[i]];
+    }
+
+    free(pts);
+    free(original);
+    free(next);
+    free(prev);
+    free(hull_tri);
+    free(stack);
+    free(hash);
+
+    return triangle_list;
+}
+
+/* Display all edges on stdout, in the same format
+ * as showEdges (lexicographically smaller end first)
+ */
+static void showIndexEdge(PointList *point_list, int a, int b)
+{
+    Point *points = point_list->points;
+    if (compareXY(points + b, points + a)) SWAP(a, b, int);
+
+    char text[POINT_TEXT_MAX];
+    formatPoint(text, point_list, points + a);
+    printf("%s ", text);
+    formatPoint(text, point_list, points + b);
+    printf("%s\n", text);
+}
+
+void showTriangleEdges(TriangleList *triangle_list, PointList *point_list, int *chain, size_t chain_size)
+{
+    for (size_t i = 0; i + 1 < chain_size; i++) showIndexEdge(point_list, chain[i], chain[i + 1]);
+
+    Triangle *triangles = triangle_list->triangles;
+    for (size_t t = 0; t < triangle_list->idx; t++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            int u = triangles[t].n[i];
+            if (u < 0 || (size_t)u > t) showIndexEdge(point_list, triangles[t].v[NEXT(i)], triangles[t].v[PREV(i)]);
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include "verify.h"
+#include "topology.h"
+
+/* Self-check of a finished triangulation.
+ *
+ * Every half-edge in use is checked once, going
+ * through the slots of the edge list in order (so
+ * that memory is read mostly in sequence), spread
+ * over the threads:
+ *  - twin, dnext and oprev agree with each other,
+ *  - an interior edge is locally Delaunay, that is
+ *    the apex beyond it is outside the circle of the
+ *    triangle on its right (one inCircle per edge),
+ *    unless it is fixed (constrained Delaunay),
+ *  - the outer face turns left or goes straight at
+ *    every hull vertex, and onConvexHull holds for
+ *    the vertices on it.
+ * Counting triangles, edges and outer half-edges
+ * then gives Euler's formula, once a walk round the
+ * outer face has shown it to be a single cycle.
+ *
+ * inCircle is exact in both variants, as in the
+ * triangulation itself
+ */
+
+typedef struct
+{
+    size_t edges;
+    size_t triangles;
+    size_t hull_edges;
+    size_t bad_links;
+    size_t not_delaunay;
+    size_t bad_hull;
+} Counts;
+
+static int linksAgree(Edge *e)
+{
+    Edge *t = e->twin;
+    if (t == NULL || e->dnext == NULL || e->oprev == NULL || t->dnext == NULL) return 0;
+    return t->twin == e && t != e && t->orig != e->orig &&
+           e->dnext->orig == t->orig &&
+           e->dnext->oprev == e &&
+           e->oprev->dnext == e;
+}
+
+// Apex of the triangle on the right of e
+static Point *apex(Edge *e)
+{
+    return e->dnext->twin->orig;
+}
+
+/* Check one half-edge, in use. Links are only
+ * followed one step, and the face on the far side
+ * of an edge is only taken as a 3-cycle, its
+ * orientation being tested from its own half-edges
+ */
+static void checkEdge(Edge *f, int fixed, Counts *c, Edge **outer)
+{
+    if (!linksAgree(f) || f->orig->e == NULL)
+    {
+        (c->bad_links)++;
+        return;
+    }
+
+    Edge *t = f->twin;
+    if (isTriangle(f))
+    {
+        // Each triangle from its least half-edge
+        if (f < f->dnext && f < f->dnext->dnext) (c->triangles)++;
+
+        // f's triangle is clockwise, so reverse it
+        if (f < t && t->dnext->dnext->dnext == t && !fixed &&
+            inCircle(f->orig, apex(f), t->orig, apex(t)) > 0) (c->not_delaunay)++;
+    }
+    else
+    {
+        // The outer face is on the right of f
+        (c->hull_edges)++;
+        if (orientation(f->orig, t->orig, apex(f)) < 0) (c->bad_hull)++;
+        if (!onConvexHull(f->orig)) (c->bad_hull)++;
+
+        #pragma omp atomic write
+        *outer = f;
+    }
+
+    if (f < t) (c->edges)++;
+}
+
+/* Length of the outer face through start,
+ * walking at most limit + 1 steps
+ */
+static size_t outerCycle(Edge *start, size_t limit)
+{
+    if (start == NULL) return 0;
+
+    size_t length = 0;
+    Edge *f = start;
+    do
+    {
+        f = f->dnext;
+        length++;
+    } while (f != start && length <= limit);
+
+    return length;
+}
+
+/* Check the triangulation of point_list, whose edges
+ * are those of edge_list not on its unused stack.
+ * Returns 1 if every check passes, with the counts in v
+ */
+int verifyTriangulation(Point *point_list[], size_t num_points, EdgeList *edge_list, Verification *v)
+{
+    size_t edges = 0, triangles = 0, hull_edges = 0;
+    size_t bad_links = 0, not_delaunay = 0, bad_hull = 0;
+    Edge *outer = NULL;
+
+    char *unused = calloc(edge_list->size, sizeof *unused);
+    #pragma omp parallel for schedule(static)
+    for (size_t k = 0; k < edge_list->idx; k++) unused[(edge_list->unused_edges)[k] - edge_list->edges] = 1;
+
+    // Slots in order, for locality
+    #pragma omp parallel for schedule(dynamic, 4096) \
+        reduction(+: edges, triangles, hull_edges, bad_links, not_delaunay, bad_hull)
+    for (size_t k = 0; k < edge_list->size; k++)
+    {
+        if (unused[k]) continue;
+
+        Counts c = {0};
+        checkEdge(edge_list->edges + k, isFixed(edge_list->edges + k, edge_list), &c, &outer);
+
+        edges += c.edges;
+        triangles += c.triangles;
+        hull_edges += c.hull_edges;
+        bad_links += c.bad_links;
+        not_delaunay += c.not_delaunay;
+        bad_hull += c.bad_hull;
+    }
+    free(unused);
+
+    // Every point is on an edge of its own
+    #pragma omp parallel for schedule(static) reduction(+: bad_links)
+    for (size_t idx = 0; idx < num_points; idx++)
+    {
+        Edge *e = point_list[idx]->e;
+        if (num_points > 1 && (e == NULL || e->orig != point_list[idx])) bad_links++;
+    }
+
+    v->vertices = num_points;
+    v->edges = edges;
+    v->triangles = triangles;
+    v->hull_edges = hull_edges;
+    v->bad_links = bad_links;
+    v->not_delaunay = not_delaunay;
+    v->bad_hull = bad_hull;
+
+    // Walking a broken mesh could go anywhere
+    v->euler = 0;
+    if (bad_links == 0)
+    {
+        int one_cycle = outerCycle(outer, hull_edges) == hull_edges;
+        v->euler = one_cycle && (num_points == 0 || num_points + triangles + 1 == edges + 2);
+    }
+
+    return v->euler && bad_links == 0 && not_delaunay == 0 && bad_hull == 0;
+}